@@ -176,7 +176,10 @@ static inline uint32_t sys(uint8_t rt, uint8_t op1, uint8_t cn, uint8_t cm, uint
 static inline uint32_t sysl(uint8_t rt, uint8_t op1, uint8_t cn, uint8_t cm, uint8_t op2) { ASSERT_REG(rt); return I32(0xd5280000 | ((op1 & 7) << 16) | ((op2 & 7) << 5) | ((cn & 15) << 12) | ((cm & 15) << 8) | (rt & 31)); }
 static inline uint32_t dc_ivac(uint8_t rt) { ASSERT_REG(rt); return sys(rt, 0, 7, 6, 1); }
 static inline uint32_t dc_civac(uint8_t rt) { ASSERT_REG(rt); return sys(rt, 3, 7, 14, 1); }
+static inline uint32_t at_s1e1r(uint8_t rt) { ASSERT_REG(rt); return sys(rt, 0, 7, 8, 0); }
+static inline uint32_t get_par(uint8_t rt) { ASSERT_REG(rt); return mrs(rt, 3, 0, 7, 4, 0); }
 static inline uint32_t dsb_sy() { return I32(0xd5033f9f); }
+static inline uint32_t isb() { return I32(0xd5033fdf); }
 static inline uint32_t dmb_ish() { return I32(0xd5033bbf); }
 static inline uint32_t nop() { return I32(0xd503201f); }
 static inline uint32_t svc(uint16_t code) { return I32(0xd4000001 | (code << 5)); }
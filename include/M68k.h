@@ -16,6 +16,7 @@
 #include "nodes.h"
 #include "md5.h"
 #include "lists.h"
+#include "config.h"
 
 struct M68KLocalState {
     void *          mls_M68kPtr;
@@ -24,8 +25,22 @@ struct M68KLocalState {
     int32_t         mls_PCRel;
 };
 
+struct M68KTranslationUnit;
+
+/* Counter of a conditional exit of the first tier unit */
+struct M68KExitProfile {
+    uint32_t        ep_M68kPC;      /* Address of the branch instruction */
+    uint32_t        ep_Taken;       /* Number of times the exit was taken */
+};
+
+/* Entry of the reverse map from m68k pages to the units covering them */
+struct M68KPageLink {
+    struct Node     pl_Node;        /* Node in the page map bucket */
+    uint32_t        pl_Page;        /* m68k page number, EMU68_PAGEMAP_WIDE for units spanning too many pages */
+    struct M68KTranslationUnit * pl_Unit;
+};
+
 struct M68KTranslationUnit {
-    struct Node     mt_HashNode;
     struct Node     mt_LRUNode;
     uint16_t *      mt_M68kAddress;
     uint16_t *      mt_M68kLow;
@@ -40,6 +55,18 @@ struct M68KTranslationUnit {
     void *          mt_ARMEntryPoint;
     struct M68KLocalState *  mt_LocalState;
     uint32_t        mt_CRC32;
+    uint32_t        mt_Tier;
+    uint32_t        mt_ExitCount;
+    uint32_t        mt_LoopCount;   /* Jumps back to the start of first tier unit */
+    struct M68KExitProfile mt_Exits[EMU68_TRACE_EXITS];
+    int32_t         mt_HotCount;
+    int32_t         mt_HotMark;
+    struct Node     mt_RegionNode;
+    struct M68KPageLink mt_PageLink;
+    struct M68KPageLink * mt_PageLinks;
+    uint32_t        mt_PageCount;
+    struct List     mt_ChainIn;
+    struct List     mt_ChainOut;
     uint32_t        mt_ARMCode[]
 #ifdef __aarch64__
     __attribute__((aligned(64)));
@@ -48,6 +75,58 @@ struct M68KTranslationUnit {
 #endif
 };
 
+/* Direct link between exit of one translation unit and entry of another one */
+struct M68KChainLink {
+    struct Node     cl_InNode;      /* Node in mt_ChainIn of the target unit */
+    struct Node     cl_OutNode;     /* Node in mt_ChainOut of the source unit */
+    uint32_t *      cl_Slot;        /* Patched instruction (RW mapping of JIT cache) */
+    uint32_t        cl_Insn;        /* Original contents of the slot */
+};
+
+/*
+    Entry of the open-addressed lookup table mapping m68k PC to the translated code. Four
+    entries share one cache line, so a lookup hit costs a single line fetch in the dispatcher.
+*/
+struct M68KLookupEntry {
+    uint32_t        le_M68kAddress; /* m68k address of the unit, M68K_LOOKUP_FREE if unused */
+    uint32_t        le_Pad;
+    void *          le_ARMEntryPoint; /* Copy of mt_ARMEntryPoint of the unit */
+};
+
+#define M68K_LOOKUP_FREE    0xffffffff
+
+extern struct M68KLookupEntry ICache[EMU68_LOOKUP_SIZE];
+
+static inline uint32_t M68K_LookupHash(uint32_t pc)
+{
+    return ((pc ^ (pc >> EMU68_LOOKUP_BITS)) >> 1) & EMU68_LOOKUP_MASK;
+}
+
+/* Returns entry point of translated code for given m68k PC, or NULL if there is none */
+static inline void *M68K_LookupEntryPoint(uint32_t pc)
+{
+    uint32_t idx = M68K_LookupHash(pc);
+
+    while(1)
+    {
+        struct M68KLookupEntry *e = &ICache[idx];
+
+        if (e->le_M68kAddress == pc)
+            return e->le_ARMEntryPoint;
+        if (e->le_M68kAddress == M68K_LOOKUP_FREE)
+            return (void *)0;
+
+        idx = (idx + 1) & EMU68_LOOKUP_MASK;
+    }
+}
+
+/* Get the translation unit from its (possibly soft flushed) entry point in executable JIT mapping */
+static inline struct M68KTranslationUnit *M68K_UnitFromEntry(void *entry)
+{
+    uintptr_t e = ((uintptr_t)entry | 0xff00000000000000ULL) & ~0x0000001000000000ULL;
+    return (struct M68KTranslationUnit *)(e - __builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode));
+}
+
 struct M68KState
 {
     /* Integer part */
@@ -123,6 +202,18 @@ struct M68KState
     uint32_t JIT_SOFTFLUSH_THRESH;
     uint32_t JIT_CONTROL;
     uint32_t JIT_CONTROL2;
+    uint32_t *JIT_CHAIN_SLOT;
+    uint32_t JIT_CACHE_HOLES;
+    uint32_t JIT_EVICT_COUNT;
+    uint32_t JIT_EVICT_UNITS;
+    uint32_t JIT_KEPT_UNITS;
+    uint32_t JIT_SNAPSHOT_SIZE;
+    uint32_t JIT_WPROT_FAULTS;
+    uint32_t JIT_WORKER_UNITS;
+    uint32_t JIT_FAULT_PATCHES;
+
+    uint32_t PROF_PERIOD;
+    uint32_t PROF_SAMPLES;
 };
 
 #define JCCB_SOFT               0
@@ -387,12 +478,49 @@ struct M68KState
 uint32_t *EMIT_GetOffsetPC(uint32_t *ptr, int8_t *offset);
 uint32_t *EMIT_AdvancePC(uint32_t *ptr, uint8_t offset);
 uint32_t *EMIT_FlushPC(uint32_t *ptr);
+uint32_t *EMIT_MaterializePC(uint32_t *ptr, int32_t offset);
 uint32_t *EMIT_ResetOffsetPC(uint32_t *ptr);
 uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm_reg, uint8_t ea, uint16_t *m68k_ptr, uint8_t *ext_words, uint8_t read_only, int32_t *imm_offset);
 uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm_reg, uint8_t ea, uint16_t *m68k_ptr, uint8_t *ext_words, int sign_extend);
 uint32_t *EMIT_Exception(uint32_t *ptr, uint16_t exception, uint8_t format, ...);
+/* Exit target of computed jumps (RTS, JMP, JSR). Such exits are served by an inline cache */
+#define M68K_EXIT_COMPUTED  1
+
+/* First longword of translation snapshot blob, 'E68J' */
+#define M68K_SNAPSHOT_MAGIC 0x4536384a
+
 uint32_t *EMIT_LocalExit(uint32_t *ptr, uint32_t insn_count_fixup);
+uint32_t *EMIT_ChainedLocalExit(uint32_t *ptr, uint32_t insn_count_fixup, uint16_t *target);
+uint32_t *EMIT_CountExit(uint32_t *ptr, uint16_t *branch);
+int M68K_IsHotExit(uint16_t *branch);
 uint32_t *EMIT_JumpOnCondition(uint32_t *ptr, uint8_t m68k_condition, uint32_t distance);
+extern uint32_t host_flags_branches;
+void EMIT_ResetHostFlags();
+void EMIT_SetHostFlags(uint32_t *ptr, uint8_t borrow);
+int EMIT_HasHostFlags(uint32_t *ptr);
+uint8_t EMIT_HostCondition(uint8_t m68k_condition);
+
+/* Decoded m68k instruction of the IR built ahead of emission, see M68k_IR.c */
+struct M68KIRInsn {
+    uint16_t *  ir_M68kPtr;
+    uint16_t    ir_Opcode;
+    uint8_t     ir_Length;      /* Length in 16-bit words */
+    uint8_t     ir_Kind;
+    uint8_t     ir_Flags;       /* Annotations set by the optimizer */
+};
+
+#define IR_OTHER        0
+#define IR_COMPARE      1       /* CMP, CMPA, CMPI: NZCV with carry as borrow */
+#define IR_TEST         2       /* TST: NZ with V and C cleared */
+#define IR_BCC          3
+
+#define IRF_FLAGS_OUT   0x01    /* Condition codes are consumed from NZCV by the next instruction */
+#define IRF_FLAGS_IN    0x02    /* Condition codes can be taken from NZCV left by previous instruction */
+
+extern uint32_t ir_fused_pairs;
+void M68K_IRReset();
+struct M68KIRInsn *M68K_IRSelect(uint16_t *m68k_ptr);
+struct M68KIRInsn *M68K_IRCurrent();
 
 uint32_t *EMIT_line0(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed);
 uint32_t *EMIT_line4(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed);
@@ -476,6 +604,8 @@ uint32_t *EMIT_InjectDebugString(uint32_t *ptr, const char * restrict format, ..
 
 void M68K_PushReturnAddress(uint16_t *ret_addr);
 uint16_t *M68K_PopReturnAddress(uint8_t *success);
+int M68K_CanInlineCall(uint16_t *site, uint16_t *target);
+int M68K_InCodeWindow(uint16_t *ptr);
 void M68K_ResetReturnStack();
 int M68K_GetINSNLength(uint16_t *insn_stream);
 int M68K_IsBranch(uint16_t *insn_stream);
@@ -483,10 +613,51 @@ int M68K_IsBranch(uint16_t *insn_stream);
 uint8_t EMIT_TestCondition(uint32_t **pptr, uint8_t m68k_condition);
 uint8_t EMIT_TestFPUCondition(uint32_t **pptr, uint8_t m68k_condition);
 uint8_t M68K_GetSRMask(uint16_t *m68k_stream);
+void M68K_ResetSRLiveness();
+void M68K_ResetConstants();
+void M68K_SetConstant(uint8_t m68k_reg, uint32_t value);
+int M68K_GetConstant(uint8_t m68k_reg, uint32_t *value);
+void M68K_UpdateConstants(uint32_t *start, uint32_t *end);
+
+/* Classes of absolute addresses returned by M68K_ClassifyAddress */
+#define ADDR_UNKNOWN    0
+#define ADDR_CIA        1
+#define ADDR_CUSTOM     2
+
+uint8_t M68K_ClassifyAddress(uint32_t address);
+
+/* Bus access helpers called directly from JIT code, see vectors.c */
+uint32_t SYSBusRead(uint32_t address, uint32_t size);
+void SYSBusWrite(uint32_t address, uint32_t value, uint32_t size);
+void SYSBusBenchmark();
+
+void M68K_FaultSite(uintptr_t pc);
 void M68K_InitializeCache();
 struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *ptr);
 void *M68K_TranslateNoCache(uint16_t *m68kcodeptr);
 struct M68KTranslationUnit *M68K_VerifyUnit(struct M68KTranslationUnit *unit);
+void M68K_ReleaseUnit(struct M68KTranslationUnit *unit);
+void M68K_UnlinkUnit(struct M68KTranslationUnit *unit);
+void M68K_LinkUnit(uint32_t *slot, struct M68KTranslationUnit *target);
+void M68K_SetEntryPoint(struct M68KTranslationUnit *unit, void *entry);
+void *M68K_PromoteUnit(struct M68KTranslationUnit *unit);
+uint32_t M68K_GetCacheSize();
+struct M68KTranslationUnit *M68K_LoadUnit(struct M68KTranslationUnit *tmpl, uint32_t *code);
+void M68K_LockJIT();
+void M68K_UnlockJIT();
+void M68K_EnableWorker();
+void M68K_TranslationWorker();
+void M68K_EnableWriteProtect();
+int M68K_UnitProtected(struct M68KTranslationUnit *unit);
+void M68K_SoftFlushUnit(struct M68KTranslationUnit *unit);
+int M68K_WriteProtectFault(uint64_t far);
+void M68K_ForEachUnitInRange(uint32_t start, uint32_t end, void (*func)(struct M68KTranslationUnit *));
+void M68K_LookupBenchmark();
+void M68K_ProfileSample(uintptr_t arm_pc, uint64_t *regs);
+void M68K_ProfileControl(uint32_t period);
+void M68K_ProfileReport(uint32_t buffer);
+void M68K_SnapshotSave(uint32_t buffer);
+void M68K_SnapshotLoad(void *blob, uint32_t size);
 void M68K_DumpStats();
 uint8_t M68K_GetCC(uint32_t **ptr);
 uint8_t M68K_ModifyCC(uint32_t **ptr);
@@ -38,18 +38,82 @@
 #define EMU68_DEF_BRANCH_BREAK  0
 #define EMU68_INSN_COUNTER      1
 #define EMU68_MAX_LOOP_COUNT    8
+#define EMU68_LOOP_UNROLL_BODY  16      /* Loops closed within a unit are unrolled if not longer than that */
 #define EMU68_BRANCH_INLINE_DISTANCE 8191
 #define EMU68_USE_RETURN_STACK  1
+#define EMU68_INLINE_CALL_SIZE  16      /* JSR and ROM calls are inlined if callee reaches RTS within that many instructions */
 #define EMU68_WEAK_CFLUSH       1
 #define EMU68_WEAK_CFLUSH_LIMIT 500
 
 #define EMU68_WEAK_CFLUSH_SLOW  0
 #define EMU68_PC_REG_HISTORY    0
 #define EMU68_CCR_SCAN_DEPTH    20
+#define EMU68_BLOCK_CHAINING    1
+#define EMU68_TIERED_JIT        1
+#define EMU68_JIT_WORKER        1
 
-#define EMU68_HASHSIZE          65536
-#define EMU68_HASHMASK          (EMU68_HASHSIZE - 1)
-#define EMU68_HASHSHIFT         5
+/* Tiered translation: units entered EMU68_TIER2_THRESHOLD times are translated again with settings below */
+#define EMU68_TIER2_THRESHOLD   2000
+#define EMU68_TIER2_INSN_DEPTH  0       /* 0 = maximal depth of 256 instructions */
+#define EMU68_TIER2_LOOP_COUNT  15
+#define EMU68_TIER2_INLINE_RANGE 32767
+#define EMU68_TIER2_CCR_SCAN_DEPTH 31
+
+/*
+    First tier units count how often each of up to EMU68_TRACE_EXITS conditional exits was taken. If
+    an exit was taken on at least EMU68_TRACE_HOT_PERCENT percent of entries of the unit, the second
+    tier follows the branch in that direction, so the hot path is translated as one trace
+*/
+#define EMU68_TRACE_EXITS       8
+#define EMU68_TRACE_HOT_PERCENT 50
+
+/*
+    JIT code cache is split into EMU68_JIT_REGIONS regions filled one after another. When all are full,
+    the oldest region is evicted as a whole. Units entered at least EMU68_JIT_SURVIVOR_ENTRIES times
+    since the previous eviction are kept (up to 1/EMU68_JIT_SURVIVOR_LIMIT of the region)
+*/
+#define EMU68_JIT_REGIONS       8
+#define EMU68_JIT_SURVIVOR_ENTRIES 16
+#define EMU68_JIT_SURVIVOR_LIMIT 2
+
+/*
+    Reverse map of m68k pages to JIT units, used by line and page cache flushes. The map is direct
+    mapped, units spanning more than EMU68_PAGEMAP_MAX_SPAN pages are kept on a separate list
+*/
+#define EMU68_PAGEMAP_BITS      12
+#define EMU68_PAGEMAP_SIZE      (1 << EMU68_PAGEMAP_BITS)
+#define EMU68_PAGEMAP_MAX_SPAN  32
+#define EMU68_PAGEMAP_WIDE      0xffffffff
+
+/*
+    Background translation. Successors of every translated unit are queued for the worker running on
+    CPU1, which translates them ahead of time. At most EMU68_JIT_WORKER_SUCC successors are taken
+    from one unit, the queue holds EMU68_JIT_WORKER_QUEUE (power of two) requests
+*/
+#define EMU68_JIT_WORKER_SUCC   4
+#define EMU68_JIT_WORKER_QUEUE  64
+
+/* Write protected code page loses its protection for good after that many writes to it */
+#define EMU68_WPROT_RETRIES     4
+
+/*
+    Load or store in JIT code which faulted EMU68_FAULT_PATCH_THRESHOLD times is replaced by a branch to
+    a stub calling the bus helper directly. Faults are counted in a direct mapped table of
+    EMU68_FAULT_SITES (power of two) entries, at most EMU68_FAULT_STUBS sites are patched at a time
+*/
+#define EMU68_FAULT_PATCH       1
+#define EMU68_FAULT_PATCH_THRESHOLD 8
+#define EMU68_FAULT_SITES       256
+#define EMU68_FAULT_STUBS       256
+
+#define EMU68_LOOKUP_BITS       17
+#define EMU68_LOOKUP_SIZE       (1 << EMU68_LOOKUP_BITS)
+#define EMU68_LOOKUP_MASK       (EMU68_LOOKUP_SIZE - 1)
+#define EMU68_LOOKUP_LIMIT      ((EMU68_LOOKUP_SIZE * 3) / 4)
+
+#define EMU68_PROFILE_SIZE      4096
+#define EMU68_PROFILE_TOP       64
+#define EMU68_PROFILE_MIN_PERIOD 10000
 
 #ifdef PISTORM
 
@@ -0,0 +1,61 @@
+/*
+    Copyright © 2019 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#ifndef _LSDECODE_H
+#define _LSDECODE_H
+
+#include <stdint.h>
+
+/*
+    Decoder of A64 loads and stores for the data abort handlers. The class of instruction is given by
+    bits 31:21 of the opcode, which select the size, direction, sign extension and the form of the
+    address. The table is filled once on first use, the fields which depend on remaining bits of the
+    opcode (registers, offsets, pre- or post-index) are extracted by SYSDecodeLoadStore.
+
+    The decoder has no dependencies on the hardware, it is built on the host by tests/ as well.
+*/
+#define LS_INVALID      0
+#define LS_UIMM12       1       /* Base plus unsigned 12-bit offset scaled by size */
+#define LS_IMM9         2       /* Base plus signed 9-bit offset, unscaled or pre/post-index (bits 11:10) */
+#define LS_REGOFF       3       /* Base plus extended and optionally scaled register */
+#define LS_PAIR         4       /* Pair of registers, signed 7-bit offset scaled by size (mode in bits 24:23) */
+#define LS_LITERAL      5       /* PC relative, address taken from FAR */
+#define LS_BASE         6       /* Base register only (exclusive and ordered accesses) */
+#define LS_PREFETCH     7       /* Prefetch, nothing to do */
+#define LS_FORM         7
+
+#define LSF_LOAD        0x08
+#define LSF_SEXT32      0x10    /* Sign extend the loaded value to 32 bits */
+#define LSF_SEXT64      0x20    /* Sign extend the loaded value to 64 bits */
+#define LSF_FP          0x40
+#define LSF_STATUS      0x80    /* Store exclusive, status register in bits 20:16 */
+
+#define LS_WB_NONE      0
+#define LS_WB_PRE       1
+#define LS_WB_POST      2
+
+struct LSInsn {
+    uint8_t     li_Form;
+    uint8_t     li_Flags;
+    uint8_t     li_Size;        /* Bytes per register */
+    uint8_t     li_Writeback;
+    uint8_t     li_Rt;
+    uint8_t     li_Rt2;
+    uint8_t     li_Rn;
+    uint8_t     li_Rm;          /* Offset register (LS_REGOFF) or status register (LSF_STATUS) */
+    uint8_t     li_Extend;      /* Extend option of LS_REGOFF */
+    uint8_t     li_Shift;
+    int32_t     li_Offset;
+};
+
+int SYSDecodeLoadStore(uint32_t opcode, struct LSInsn *li);
+uint64_t SYSEffectiveAddress(struct LSInsn *li, uint64_t *ctx, uint64_t far);
+uint64_t SYSExtendValue(struct LSInsn *li, uint64_t value);
+
+#endif /* _LSDECODE_H */
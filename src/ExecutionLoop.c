@@ -8,7 +8,6 @@
 #endif
 #endif
 
-extern struct List ICache[EMU68_HASHSIZE];
 void M68K_LoadContext(struct M68KState *ctx);
 void M68K_SaveContext(struct M68KState *ctx);
 
@@ -20,52 +19,15 @@ static inline void CallARMCode()
     ptr();
 }
 
-static inline struct M68KTranslationUnit *FindUnit()
+/* Find entry point of translated code for current PC in the lookup table */
+static inline void *FindUnit()
 {
     register uint16_t *PC asm("x18");
-    
-    /* Perform search */
-    uint32_t hash = (uint32_t)(uintptr_t)PC;
-    struct List *bucket = &ICache[(hash >> EMU68_HASHSHIFT) & EMU68_HASHMASK];
-    struct M68KTranslationUnit *node;
-    
-    /* Go through the list of translated units */
-    ForeachNode(bucket, node)
-    {
-        /* Force reload of PC*/
-        asm volatile("":"=r"(PC));
-
-        /* Check if unit is found */
-        if (node->mt_M68kAddress == PC)
-        {
-#if 0
-            /* Move node to front of the list */
-            REMOVE(&node->mt_HashNode);
-            ADDHEAD(bucket, &node->mt_HashNode);
-#elif 0
-            struct Node *prev = node->mt_HashNode.ln_Pred;
-            struct Node *succ = node->mt_HashNode.ln_Succ;
-            struct Node *prevprev = prev->ln_Pred;
-            
-            /* If node is not head, then move it one level up */
-            if (prevprev != NULL)
-            {
-                node->mt_HashNode.ln_Pred = prevprev;
-                node->mt_HashNode.ln_Succ = prev;
 
-                prevprev->ln_Succ = &node->mt_HashNode;
+    /* Force reload of PC*/
+    asm volatile("":"=r"(PC));
 
-                prev->ln_Succ = succ;
-                prev->ln_Pred = &node->mt_HashNode;
-
-                succ->ln_Pred = prev;
-            }
-#endif                   
-            return node;    
-        }
-    }
-
-    return NULL;
+    return M68K_LookupEntryPoint((uint32_t)(uintptr_t)PC);
 }
 
 #ifdef PISTORM
@@ -115,6 +77,19 @@ static inline uint32_t getSR()
     return sr;
 }
 
+#if EMU68_BLOCK_CHAINING
+/* Link the exit through which previous unit has left with the unit which is about to be called */
+static inline void ChainUnit(struct M68KState *ctx, struct M68KTranslationUnit *node)
+{
+    uint32_t *slot = ctx->JIT_CHAIN_SLOT;
+
+    ctx->JIT_CHAIN_SLOT = NULL;
+    M68K_SaveContext(ctx);
+    M68K_LinkUnit(slot, node);
+    M68K_LoadContext(ctx);
+}
+#endif
+
 static inline void setLastPC(uint16_t *pc)
 {
     asm volatile("msr TPIDR_EL1, %0"::"r"(pc));
@@ -267,23 +242,40 @@ void MainLoop()
             if (LastPC == PC)
             {
                 asm volatile("":"=r"(ARM));
+#if EMU68_BLOCK_CHAINING
+                /* Exit of previous unit waits for linking? Unit is known from its entry point in x12 */
+                if (unlikely(ctx->JIT_CHAIN_SLOT != NULL))
+                {
+                    ChainUnit(ctx, M68K_UnitFromEntry(ARM));
+                    asm volatile("":"=r"(ARM));
+                }
+#endif
                 /* Jump to the code now */
                 CallARMCode();
                 continue;
             }
             else
             {
-                /* Find unit in the hashtable based on the PC value */
-                struct M68KTranslationUnit *node = FindUnit();
+                /* Find unit in the lookup table based on the PC value */
+                void *entry = FindUnit();
+                struct M68KTranslationUnit *node;
 
                 /* Unit exists ? */
-                if (node != NULL)
+                if (entry != NULL)
                 {
+#if EMU68_BLOCK_CHAINING
+                    /* Exit of previous unit waits for linking? */
+                    if (unlikely(ctx->JIT_CHAIN_SLOT != NULL))
+                    {
+                        ChainUnit(ctx, M68K_UnitFromEntry(entry));
+                        asm volatile("":"=r"(PC));
+                    }
+#endif
                     /* Store m68k PC of corresponding ARM code in TPIDR_EL1 */
                     asm volatile("msr TPIDR_EL1, %0"::"r"(PC));
 
                     /* This is the case, load entry point into x12 */
-                    ARM = node->mt_ARMEntryPoint;
+                    ARM = entry;
                     asm volatile("":"=r"(ARM):"0"(ARM));
                     
                     CallARMCode();
@@ -298,6 +290,15 @@ void MainLoop()
                 M68K_SaveContext(ctx);
                 /* Get the code. This never fails */
                 node = M68K_GetTranslationUnit(copyPC);
+#if EMU68_BLOCK_CHAINING
+                /* Link the exit of previous unit if it waits for that */
+                if (ctx->JIT_CHAIN_SLOT != NULL)
+                {
+                    uint32_t *slot = ctx->JIT_CHAIN_SLOT;
+                    ctx->JIT_CHAIN_SLOT = NULL;
+                    M68K_LinkUnit(slot, node);
+                }
+#endif
                 /* Load CPU context */
                 M68K_LoadContext(getCTX());
                 asm volatile("msr TPIDR_EL1, %0"::"r"(PC));
@@ -310,19 +311,23 @@ void MainLoop()
         else
         {
             struct M68KTranslationUnit *node = NULL;
+            void *entry;
 
             /* Uncached mode - reset LastPC */
             setLastPC((void*)~(0));
+#if EMU68_BLOCK_CHAINING
+            ctx->JIT_CHAIN_SLOT = NULL;
+#endif
 
             /* Save context since C code will be called */
             M68K_SaveContext(ctx);
 
             /* Find the unit */
-            node = FindUnit();
+            entry = FindUnit();
             /* If node is found verify it */
-            if (likely(node != NULL))
+            if (likely(entry != NULL))
             {
-                node = M68K_VerifyUnit(node);
+                node = M68K_VerifyUnit(M68K_UnitFromEntry(entry));
             }
             /* If node was not found or invalidated, translate code */
             if (unlikely(node == NULL))
@@ -12,6 +12,52 @@
 #include "M68k.h"
 #include "RegisterAllocator.h"
 
+/*
+    Flags of the ARM CPU left by the last compare or test. As long as no further code was emitted
+    after such instruction, NZCV of the ARM CPU holds the m68k condition codes and the following
+    Bcc can branch on them directly, without testing bits of the CC register. Compares leave the
+    carry inverted, as in m68k it is the borrow. Such pairs are found by the IR optimizer ahead of
+    emission, the pointer check only makes sure nothing was emitted in between.
+*/
+static uint32_t *host_flags_ptr;
+static uint8_t host_flags_borrow;
+uint32_t host_flags_branches;
+
+void EMIT_ResetHostFlags()
+{
+    host_flags_ptr = NULL;
+    host_flags_branches = 0;
+}
+
+void EMIT_SetHostFlags(uint32_t *ptr, uint8_t borrow)
+{
+    host_flags_ptr = ptr;
+    host_flags_borrow = borrow;
+}
+
+int EMIT_HasHostFlags(uint32_t *ptr)
+{
+    return ptr == host_flags_ptr;
+}
+
+/* Get ARM condition equivalent to m68k one on the host flags, or 0xff if there is none */
+uint8_t EMIT_HostCondition(uint8_t m68k_condition)
+{
+    static const uint8_t cond_borrow[16] = {
+        0xff, 0xff, A64_CC_HI, A64_CC_LS, A64_CC_CS, A64_CC_CC, A64_CC_NE, A64_CC_EQ,
+        A64_CC_VC, A64_CC_VS, A64_CC_PL, A64_CC_MI, A64_CC_GE, A64_CC_LT, A64_CC_GT, A64_CC_LE
+    };
+    static const uint8_t cond_carry[16] = {
+        0xff, 0xff, 0xff, 0xff, A64_CC_CC, A64_CC_CS, A64_CC_NE, A64_CC_EQ,
+        A64_CC_VC, A64_CC_VS, A64_CC_PL, A64_CC_MI, A64_CC_GE, A64_CC_LT, A64_CC_GT, A64_CC_LE
+    };
+
+    if (host_flags_borrow)
+        return cond_borrow[m68k_condition & 15];
+    else
+        return cond_carry[m68k_condition & 15];
+}
+
 uint32_t * EMIT_JumpOnCondition(uint32_t *ptr, uint8_t m68k_condition, uint32_t distance)
 {
 	uint8_t cond_tmp = 0xff;
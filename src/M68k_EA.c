@@ -105,6 +105,218 @@ static inline __attribute__((always_inline)) uint32_t * load_s16_ext32(uint32_t
     return ptr;
 }
 
+/*
+    Registers with value known at translation time. A register gets known value after LEA of an
+    absolute or PC-relative address, or after MOVE.L/MOVEA #imm, and loses it as soon as any ARM
+    instruction of the unit writes to the host register it is mapped to. The code of a unit is
+    linear (the only jump back goes to its very beginning), so the state is valid till its end.
+*/
+static uint16_t const_known;
+static uint16_t const_pending;
+static uint32_t const_value[16];
+
+void M68K_ResetConstants()
+{
+    const_known = 0;
+    const_pending = 0;
+}
+
+/* Value becomes known after the current instruction is completed */
+void M68K_SetConstant(uint8_t m68k_reg, uint32_t value)
+{
+    const_pending |= 1 << (m68k_reg & 15);
+    const_value[m68k_reg & 15] = value;
+}
+
+int M68K_GetConstant(uint8_t m68k_reg, uint32_t *value)
+{
+    if (const_known & (1 << (m68k_reg & 15)))
+    {
+        *value = const_value[m68k_reg & 15];
+        return 1;
+    }
+
+    return 0;
+}
+
+static void const_invalidate(uint8_t arm_reg)
+{
+    for (int i=0; i < 16; i++)
+    {
+        if (RA_MapM68kRegister(NULL, i) == arm_reg)
+            const_known &= ~(1 << i);
+    }
+}
+
+/*
+    Called after every translated instruction with ARM code emitted for it. Every register which is
+    the destination of any instruction (or could be one, the check is conservative) loses its known
+    value, then the values set by the instruction itself are applied.
+*/
+void M68K_UpdateConstants(uint32_t *start, uint32_t *end)
+{
+    if (const_known != 0)
+    {
+        uint32_t saved = 0;
+
+        for (uint32_t *p = start; p < end; p++)
+        {
+            uint32_t insn = INSN_TO_LE(*p);
+
+            /*
+                Host SP is never used for m68k state. It is addressed only by EMIT_SaveRegFrame and
+                EMIT_RestoreRegFrame around calls to helpers, which store registers to the frame and load
+                the same values back within the code of one m68k instruction. Stores to the frame change
+                no register, loads from it keep known values of registers saved before. Any other load
+                from the frame breaks that assumption, it is reported and treated as a write.
+            */
+            if ((insn & 0xffc003e0) == 0xf90003e0)
+            {
+                saved |= 1 << (insn & 31);
+                continue;
+            }
+            else if ((insn & 0xffc003e0) == 0xa90003e0)
+            {
+                saved |= (1 << (insn & 31)) | (1 << ((insn >> 10) & 31));
+                continue;
+            }
+            else if ((insn & 0xffc003e0) == 0xf94003e0 || (insn & 0xffc003e0) == 0xa94003e0)
+            {
+                uint32_t regs = 1 << (insn & 31);
+
+                if ((insn & 0xffc003e0) == 0xa94003e0)
+                    regs |= 1 << ((insn >> 10) & 31);
+
+                if ((saved & regs) == regs)
+                    continue;
+
+                kprintf("[ASSERT] %s: Load from stack frame of registers not saved before (%08x)\n", __PRETTY_FUNCTION__, insn);
+            }
+
+            const_invalidate(insn & 31);
+
+            /* Load/store pair: second register and the base in writeback forms */
+            if ((insn & 0x3a000000) == 0x28000000)
+            {
+                const_invalidate((insn >> 10) & 31);
+                if (insn & 0x00800000)
+                    const_invalidate((insn >> 5) & 31);
+            }
+            /* Load/store register, pre- or post-indexed */
+            else if ((insn & 0x3b200400) == 0x38000400)
+            {
+                const_invalidate((insn >> 5) & 31);
+            }
+        }
+    }
+
+    const_known |= const_pending;
+    const_pending = 0;
+}
+
+/*
+    Classify absolute address known at translation time. Accesses to chip registers can bypass
+    the faulting load/store and go to the bus directly.
+*/
+uint8_t M68K_ClassifyAddress(uint32_t address)
+{
+#ifdef PISTORM
+    if ((address & 0xff0000) == 0xbf0000 && (address >> 24) == 0)
+        return ADDR_CIA;
+    if ((address & 0xfff000) == 0xdff000 && (address >> 24) == 0)
+        return ADDR_CUSTOM;
+#else
+    (void)address;
+#endif
+    return ADDR_UNKNOWN;
+}
+
+/*
+    Find register with known value close enough to the absolute address, so that the access can be
+    done with an unscaled offset to that register instead of building the address first. Returns
+    the ARM register or 0xff if none was found.
+*/
+static uint8_t const_find_base(uint32_t address, int32_t *offset)
+{
+    uint16_t known = const_known;
+
+    /* Prefer address registers */
+    for (int i=15; i >= 0; i--)
+    {
+        if (known & (1 << i))
+        {
+            int64_t diff = (int64_t)address - (int64_t)const_value[i];
+
+            if (diff > -256 && diff < 256)
+            {
+                *offset = (int32_t)diff;
+                return RA_MapM68kRegister(NULL, i);
+            }
+        }
+    }
+
+    return 0xff;
+}
+
+/*
+    Classify an access to an address known at translation time. Accesses to chip registers are done
+    by a direct call to the bus helper instead of a load or store which would trap into the data
+    abort handler. Returns ADDR_UNKNOWN if the access has to be emitted as usual.
+*/
+static uint8_t bus_address(uint8_t size, uint32_t address)
+{
+    if (size != 1 && size != 2 && size != 4)
+        return ADDR_UNKNOWN;
+
+    return M68K_ClassifyAddress(address);
+}
+
+static uint32_t * EMIT_BusCall(uint32_t *ptr, uintptr_t func, uint32_t address, uint8_t size)
+{
+    *ptr++ = movw_immed_u16(0, address & 0xffff);
+    *ptr++ = movt_immed_u16(0, address >> 16);
+    *ptr++ = mov_immed_u16(2, size, 0);
+    *ptr++ = mov64_immed_u16(3, func >> 48, 0);
+    *ptr++ = movk64_immed_u16(3, func >> 32, 1);
+    *ptr++ = movk64_immed_u16(3, func >> 16, 2);
+    *ptr++ = movk64_immed_u16(3, func, 3);
+    *ptr++ = blr(3);
+
+    return ptr;
+}
+
+/* Result is in w0, the destination register is left out of the register frame */
+static uint32_t * EMIT_BusLoad(uint32_t *ptr, uint8_t size, uint8_t reg, uint32_t address, int sign_ext)
+{
+    uint32_t mask = (RA_GetTempAllocMask() | REG_PROTECT | 14) & ~(1 << reg);
+
+    ptr = EMIT_SaveRegFrame(ptr, mask);
+    ptr = EMIT_BusCall(ptr, (uintptr_t)SYSBusRead, address, size);
+
+    if (sign_ext && size == 1)
+        *ptr++ = sxtb(reg, 0);
+    else if (sign_ext && size == 2)
+        *ptr++ = sxth(reg, 0);
+    else
+        *ptr++ = mov_reg(reg, 0);
+
+    ptr = EMIT_RestoreRegFrame(ptr, mask);
+
+    return ptr;
+}
+
+static uint32_t * EMIT_BusStore(uint32_t *ptr, uint8_t size, uint8_t reg, uint32_t address)
+{
+    uint32_t mask = RA_GetTempAllocMask() | REG_PROTECT | 15;
+
+    ptr = EMIT_SaveRegFrame(ptr, mask);
+    *ptr++ = mov_reg(1, reg);
+    ptr = EMIT_BusCall(ptr, (uintptr_t)SYSBusWrite, address, size);
+    ptr = EMIT_RestoreRegFrame(ptr, mask);
+
+    return ptr;
+}
+
 static inline __attribute__((always_inline)) uint32_t * load_reg_from_addr_offset(uint32_t *ptr, uint8_t size, uint8_t base, uint8_t reg, int32_t offset, uint8_t offset_32bit, int sign_ext)
 {
     uint8_t reg_d16 = RA_AllocARMRegister(&ptr);
@@ -605,6 +817,7 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
     uint8_t sign_ext = 0;
     uint8_t mode = ea >> 3;
     uint8_t src_reg = ea & 7;
+    uint32_t known;
 
     if (size & 0x80)
     {
@@ -712,6 +925,10 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
                     *ptr++ = mov_reg(*arm_reg, tmp);
                 }
             }
+            else if (M68K_GetConstant(src_reg + 8, &known) && bus_address(size, known) != ADDR_UNKNOWN)
+            {
+                ptr = EMIT_BusLoad(ptr, size, *arm_reg, known, sign_ext);
+            }
             else
             {
                 uint8_t reg_An = RA_MapM68kRegister(&ptr, src_reg + 8);
@@ -843,10 +1060,18 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
             }
             else
             {
-                uint8_t reg_An = RA_MapM68kRegister(&ptr, src_reg + 8);
                 int16_t off16 = (int16_t)cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
 
-                ptr = load_reg_from_addr_offset(ptr, size, reg_An, *arm_reg, off16, 0, sign_ext);
+                if (M68K_GetConstant(src_reg + 8, &known) && bus_address(size, known + off16) != ADDR_UNKNOWN)
+                {
+                    ptr = EMIT_BusLoad(ptr, size, *arm_reg, known + off16, sign_ext);
+                }
+                else
+                {
+                    uint8_t reg_An = RA_MapM68kRegister(&ptr, src_reg + 8);
+
+                    ptr = load_reg_from_addr_offset(ptr, size, reg_An, *arm_reg, off16, 0, sign_ext);
+                }
             }
         }
         else if (mode == 6) /* Mode 006: (d8, An, Xn.SIZE*SCALE) */
@@ -1317,11 +1542,17 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
             else if (src_reg == 0)
             {
                 uint16_t lo16;
+                uint8_t base_reg;
+                int32_t base_off;
                 lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
 
                 if (size == 0) {
                     ptr = load_s16_ext32(ptr, *arm_reg, lo16);
                 }
+                else if ((base_reg = const_find_base((int16_t)lo16, &base_off)) != 0xff)
+                {
+                    ptr = load_reg_from_addr_offset(ptr, size, base_reg, *arm_reg, base_off, 0, sign_ext);
+                }
                 else
                 {
                     uint8_t tmp_reg = RA_AllocARMRegister(&ptr);
@@ -1333,6 +1564,8 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
             else if (src_reg == 1)
             {
                 uint16_t hi16, lo16;
+                uint8_t base_reg;
+                int32_t base_off;
                 hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
                 lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
 
@@ -1352,6 +1585,14 @@ uint32_t *EMIT_LoadFromEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *ar
                         *ptr++ = mov_immed_u16(*arm_reg, hi16, 1);
                     }
                 }
+                else if (bus_address(size, ((uint32_t)hi16 << 16) | lo16) != ADDR_UNKNOWN)
+                {
+                    ptr = EMIT_BusLoad(ptr, size, *arm_reg, ((uint32_t)hi16 << 16) | lo16, sign_ext);
+                }
+                else if ((base_reg = const_find_base(((uint32_t)hi16 << 16) | lo16, &base_off)) != 0xff)
+                {
+                    ptr = load_reg_from_addr_offset(ptr, size, base_reg, *arm_reg, base_off, 0, sign_ext);
+                }
                 else
                 {
                     uint8_t tmp_reg = RA_AllocARMRegister(&ptr);
@@ -1468,6 +1709,7 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
 {
     uint8_t mode = ea >> 3;
     uint8_t src_reg = ea & 7;
+    uint32_t known;
     (void)ext_words;
     (void)m68k_ptr;
     if (size == 0)
@@ -1554,6 +1796,10 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
                 uint8_t tmp = RA_MapM68kRegister(&ptr, src_reg + 8);
                 *ptr++ = mov_reg(*arm_reg, tmp);
             }
+            else if (M68K_GetConstant(src_reg + 8, &known) && bus_address(size, known) != ADDR_UNKNOWN)
+            {
+                ptr = EMIT_BusStore(ptr, size, *arm_reg, known);
+            }
             else
             {
                 uint8_t reg_An = RA_MapM68kRegister(&ptr, src_reg + 8);
@@ -1626,10 +1872,18 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
         }
         else if (mode == 5) /* Mode 005: (d16, An) */
         {
-            uint8_t reg_An = RA_MapM68kRegister(&ptr, src_reg + 8);
             int16_t off16 = (int16_t)cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
 
-            ptr = store_reg_to_addr_offset(ptr, size, reg_An, *arm_reg, off16, 0);
+            if (M68K_GetConstant(src_reg + 8, &known) && bus_address(size, known + off16) != ADDR_UNKNOWN)
+            {
+                ptr = EMIT_BusStore(ptr, size, *arm_reg, known + off16);
+            }
+            else
+            {
+                uint8_t reg_An = RA_MapM68kRegister(&ptr, src_reg + 8);
+
+                ptr = store_reg_to_addr_offset(ptr, size, reg_An, *arm_reg, off16, 0);
+            }
         }
         else if (mode == 6) /* Mode 006: (d8, An, Xn.SIZE*SCALE) */
         {
@@ -2079,11 +2333,17 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
             else if (src_reg == 0)
             {
                 uint16_t lo16;
+                uint8_t base_reg;
+                int32_t base_off;
                 lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
 
                 if (size == 0) {
                     ptr = load_s16_ext32(ptr, *arm_reg, lo16);
                 }
+                else if ((base_reg = const_find_base((int16_t)lo16, &base_off)) != 0xff)
+                {
+                    ptr = store_reg_to_addr_offset(ptr, size, base_reg, *arm_reg, base_off, 0);
+                }
                 else
                 {
                     uint8_t tmp_reg = RA_AllocARMRegister(&ptr);
@@ -2095,6 +2355,8 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
             else if (src_reg == 1)
             {
                 uint16_t lo16, hi16;
+                uint8_t base_reg;
+                int32_t base_off;
                 hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
                 lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
 
@@ -2114,6 +2376,14 @@ uint32_t *EMIT_StoreToEffectiveAddress(uint32_t *ptr, uint8_t size, uint8_t *arm
                         *ptr++ = mov_immed_u16(*arm_reg, hi16, 1);
                     }
                 }
+                else if (bus_address(size, ((uint32_t)hi16 << 16) | lo16) != ADDR_UNKNOWN)
+                {
+                    ptr = EMIT_BusStore(ptr, size, *arm_reg, ((uint32_t)hi16 << 16) | lo16);
+                }
+                else if ((base_reg = const_find_base(((uint32_t)hi16 << 16) | lo16, &base_off)) != 0xff)
+                {
+                    ptr = store_reg_to_addr_offset(ptr, size, base_reg, *arm_reg, base_off, 0);
+                }
                 else
                 {
                     uint8_t tmp_reg = RA_AllocARMRegister(&ptr);
@@ -0,0 +1,139 @@
+/*
+    Copyright © 2019 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include "support.h"
+#include "M68k.h"
+#include "cache.h"
+
+/*
+    Lightweight intermediate representation of the m68k code being translated. Before an instruction
+    is emitted, the straight-line run of instructions starting at it (up to and including the first
+    branch, at most IR_WINDOW_SIZE instructions) is decoded into IR records. The optimizer pass walks
+    over the records and annotates instructions which can be lowered together. The EMIT_* routines are
+    the backend, they lower one instruction at a time and consult the annotation of the instruction
+    being emitted.
+
+    The window is rebuilt whenever the translator continues at an address which is not the next record,
+    i.e. after an inlined branch, a loop back or at the start of the unit.
+*/
+
+#define IR_WINDOW_SIZE  32
+
+static struct M68KIRInsn ir_window[IR_WINDOW_SIZE];
+static int ir_count;
+static int ir_pos;
+uint32_t ir_fused_pairs;
+
+static uint8_t IR_Classify(uint16_t opcode)
+{
+    /* CMP and CMPA. EOR and CMPM share line B, but have bit 8 set with size other than 3 */
+    if ((opcode & 0xf000) == 0xb000 && ((opcode & 0x0100) == 0 || (opcode & 0x00c0) == 0x00c0))
+        return IR_COMPARE;
+
+    /* CMPI */
+    if ((opcode & 0xff00) == 0x0c00 && (opcode & 0x00c0) != 0x00c0)
+        return IR_COMPARE;
+
+    /* TST */
+    if ((opcode & 0xff00) == 0x4a00 && (opcode & 0x00c0) != 0x00c0)
+        return IR_TEST;
+
+    /* Bcc, without BRA and BSR */
+    if ((opcode & 0xf000) == 0x6000 && (opcode & 0x0e00) != 0)
+        return IR_BCC;
+
+    return IR_OTHER;
+}
+
+/* Decode the straight-line run of code starting at given address */
+static void IR_Build(uint16_t *m68k_ptr)
+{
+    ir_count = 0;
+    ir_pos = 0;
+
+    while (ir_count < IR_WINDOW_SIZE && M68K_InCodeWindow(m68k_ptr))
+    {
+        struct M68KIRInsn *ir = &ir_window[ir_count];
+        int length = M68K_GetINSNLength(m68k_ptr);
+
+        if (length <= 0)
+            break;
+
+        ir->ir_M68kPtr = m68k_ptr;
+        ir->ir_Opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)m68k_ptr);
+        ir->ir_Length = length;
+        ir->ir_Kind = IR_Classify(ir->ir_Opcode);
+        ir->ir_Flags = 0;
+
+        ir_count++;
+
+        if (M68K_IsBranch(m68k_ptr))
+            break;
+
+        m68k_ptr += length;
+    }
+}
+
+/*
+    Optimizer pass. A compare or test directly followed by Bcc leaves the m68k condition codes in
+    NZCV of the ARM CPU, so that the Bcc can branch on them instead of on the CC register.
+*/
+static void IR_Optimize()
+{
+    for (int i=0; i + 1 < ir_count; i++)
+    {
+        struct M68KIRInsn *ir = &ir_window[i];
+
+        if ((ir->ir_Kind == IR_COMPARE || ir->ir_Kind == IR_TEST) && ir[1].ir_Kind == IR_BCC)
+        {
+            ir[0].ir_Flags |= IRF_FLAGS_OUT;
+            ir[1].ir_Flags |= IRF_FLAGS_IN;
+            ir_fused_pairs++;
+        }
+    }
+}
+
+void M68K_IRReset()
+{
+    ir_count = 0;
+    ir_pos = 0;
+    ir_fused_pairs = 0;
+}
+
+/*
+    Select the IR record of instruction at given address as the current one. If the address is not
+    covered by the window (and is not the next instruction in it), new window is built and optimized.
+    Returns NULL if the instruction could not be decoded.
+*/
+struct M68KIRInsn *M68K_IRSelect(uint16_t *m68k_ptr)
+{
+    for (int i = ir_pos; i < ir_count; i++)
+    {
+        if (ir_window[i].ir_M68kPtr == m68k_ptr)
+        {
+            ir_pos = i;
+            return &ir_window[i];
+        }
+    }
+
+    IR_Build(m68k_ptr);
+    IR_Optimize();
+
+    return ir_count ? &ir_window[0] : NULL;
+}
+
+/* Record of the instruction being emitted, or NULL if there is none */
+struct M68KIRInsn *M68K_IRCurrent()
+{
+    if (ir_pos < ir_count)
+        return &ir_window[ir_pos];
+    else
+        return NULL;
+}
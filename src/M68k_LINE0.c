@@ -131,6 +131,9 @@ uint32_t *EMIT_CMPI(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
         if (update_mask & SR_C)
             ptr = EMIT_SetFlagsConditional(ptr, cc, SR_Calt, ARM_CC_CC);
     }
+
+    EMIT_SetHostFlags(ptr, 1);
+
     return ptr;
 }
 
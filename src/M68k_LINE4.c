@@ -22,6 +22,7 @@ uint32_t *EMIT_MUL_DIV_(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uin
 
 
 extern uint32_t insn_count;
+extern uint16_t * m68k_exit_target;
 
 uint32_t *EMIT_CLR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
@@ -887,6 +888,9 @@ uint32_t *EMIT_TST(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t
         if (update_mask & SR_N)
             ptr = EMIT_SetFlagsConditional(ptr, cc, SR_N, ARM_CC_MI);
     }
+
+    EMIT_SetHostFlags(ptr, 0);
+
     return ptr;
 }
 
@@ -1779,11 +1783,14 @@ static uint32_t *EMIT_RTS(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
         *tmp = b_cc(ARM_CC_EQ, ptr - tmp);
         *ptr++ = (uint32_t)(uintptr_t)tmp;
         *ptr++ = 1;
-        *ptr++ = 0;
+        *ptr++ = M68K_EXIT_COMPUTED;
         *ptr++ = INSN_TO_LE(0xfffffffe);
     }
     else
+    {
+        m68k_exit_target = (uint16_t *)M68K_EXIT_COMPUTED;
         *ptr++ = INSN_TO_LE(0xffffffff);
+    }
 
     return ptr;
 }
@@ -1796,12 +1803,12 @@ static uint32_t *EMIT_TRAPV(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
     uint8_t cc = RA_GetCC(&ptr);
     uint32_t *tmpptr;
     ptr = EMIT_AdvancePC(ptr, 2);
-    ptr = EMIT_FlushPC(ptr);
 
     *ptr++ = ands_immed(31, cc, 1, 32 - SRB_Valt);
     tmpptr = ptr;
     *ptr++ = b_cc(A64_CC_EQ, 0);
     
+    ptr = EMIT_MaterializePC(ptr, 0);
     ptr = EMIT_Exception(ptr, VECTOR_TRAPcc, 2, (uint32_t)(uintptr_t)(*m68k_ptr - 1));
 
     *tmpptr = b_cc(A64_CC_EQ, ptr - tmpptr);
@@ -1843,6 +1850,30 @@ static uint32_t *EMIT_RTR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
     return ptr;
 }
 
+/* Call emulator helper function with value of the ARM register as argument. All live registers are preserved */
+static uint32_t *EMIT_CallHelper(uint32_t *ptr, void (*func)(uint32_t), uint8_t reg)
+{
+    union {
+        uint64_t u64;
+        uint16_t u16[4];
+    } u;
+
+    u.u64 = (uintptr_t)func;
+
+    ptr = EMIT_SaveRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT | 3);
+
+    *ptr++ = mov_reg(0, reg);
+    *ptr++ = mov64_immed_u16(1, u.u16[3], 0);
+    *ptr++ = movk64_immed_u16(1, u.u16[2], 1);
+    *ptr++ = movk64_immed_u16(1, u.u16[1], 2);
+    *ptr++ = movk64_immed_u16(1, u.u16[0], 3);
+    *ptr++ = blr(1);
+
+    ptr = EMIT_RestoreRegFrame(ptr, RA_GetTempAllocMask() | REG_PROTECT | 3);
+
+    return ptr;
+}
+
 static uint32_t *EMIT_MOVEC(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
     (void)insn_consumed;
@@ -1980,6 +2011,15 @@ static uint32_t *EMIT_MOVEC(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
             case 0x1e0: /* JITCTRL2 - JIT second control register */
                 *ptr++ = str_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_CONTROL2));
                 break;
+            case 0x1e1: /* PROFCTRL - Profiler sample period in CPU cycles, 0 stops profiling */
+                ptr = EMIT_CallHelper(ptr, M68K_ProfileControl, reg);
+                break;
+            case 0x1e2: /* PROFREPORT - Write profiler report to the buffer at given address */
+                ptr = EMIT_CallHelper(ptr, M68K_ProfileReport, reg);
+                break;
+            case 0x1e7: /* JITSNAPSHOT - Store translation snapshot of ROM code in the buffer at given address */
+                ptr = EMIT_CallHelper(ptr, M68K_SnapshotSave, reg);
+                break;
             case 0x003: // TCR - write bits 15, 14, read all zeros for now
                 tmp = RA_AllocARMRegister(&ptr);
                 *ptr++ = bic_immed(tmp, reg, 30, 16);
@@ -2203,6 +2243,36 @@ static uint32_t *EMIT_MOVEC(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr,
             case 0x1e0: /* JITCTRL2 - JIT second control register */
                 *ptr++ = ldr_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_CONTROL2));
                 break;
+            case 0x1e1: /* PROFCTRL - Profiler sample period in CPU cycles, 0 stops profiling */
+                *ptr++ = ldr_offset(ctx, reg, __builtin_offsetof(struct M68KState, PROF_PERIOD));
+                break;
+            case 0x1e2: /* PROFREPORT - Total number of profiler samples */
+                *ptr++ = ldr_offset(ctx, reg, __builtin_offsetof(struct M68KState, PROF_SAMPLES));
+                break;
+            case 0x1e3: /* JITHOLES - Bytes of JIT cache lost in holes until the region is evicted */
+                *ptr++ = ldr_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_CACHE_HOLES));
+                break;
+            case 0x1e4: /* JITEVICT - Number of JIT cache region evictions */
+                *ptr++ = ldr_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_EVICT_COUNT));
+                break;
+            case 0x1e5: /* JITEVUNITS - Number of JIT units discarded by region evictions */
+                *ptr++ = ldr_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_EVICT_UNITS));
+                break;
+            case 0x1e6: /* JITKEPT - Number of JIT units kept by region evictions */
+                *ptr++ = ldr_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_KEPT_UNITS));
+                break;
+            case 0x1e7: /* JITSNAPSHOT - Size of the last translation snapshot */
+                *ptr++ = ldr_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_SNAPSHOT_SIZE));
+                break;
+            case 0x1e8: /* JITWPFAULTS - Number of writes to write protected code pages */
+                *ptr++ = ldr_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_WPROT_FAULTS));
+                break;
+            case 0x1e9: /* JITWORKER - Number of units translated in background and taken over by dispatcher */
+                *ptr++ = ldr_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_WORKER_UNITS));
+                break;
+            case 0x1ea: /* JITFPATCH - Number of faulting loads and stores patched to call the bus helper */
+                *ptr++ = ldr_offset(ctx, reg, __builtin_offsetof(struct M68KState, JIT_FAULT_PATCHES));
+                break;
             case 0x003: // TCR - write bits 15, 14, read all zeros for now
                 *ptr++ = ldrh_offset(ctx, reg, __builtin_offsetof(struct M68KState, TCR));
                 break;
@@ -2284,6 +2354,25 @@ static uint32_t *EMIT_MOVEUSP(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_pt
     return ptr;
 }
 
+/*
+    Get the target of JMP/JSR. For absolute and PC relative addressing modes the target is known
+    at translation time and the exit can be chained, all other modes are computed jumps
+*/
+static uint16_t *GetJumpTarget(uint16_t opcode, uint16_t *ext_ptr)
+{
+    switch (opcode & 0x3f)
+    {
+        case 0x38:  /* (xxx).W */
+            return (uint16_t *)(uintptr_t)(uint32_t)(int16_t)cache_read_16(ICACHE, (uintptr_t)&ext_ptr[0]);
+        case 0x39:  /* (xxx).L */
+            return (uint16_t *)(uintptr_t)cache_read_32(ICACHE, (uintptr_t)&ext_ptr[0]);
+        case 0x3a:  /* (d16, PC) */
+            return (uint16_t *)(uintptr_t)(uint32_t)((uintptr_t)ext_ptr + (int16_t)cache_read_16(ICACHE, (uintptr_t)&ext_ptr[0]));
+        default:
+            return (uint16_t *)M68K_EXIT_COMPUTED;
+    }
+}
+
 static uint32_t *EMIT_JSR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 {
     (void)insn_consumed;
@@ -2299,9 +2388,23 @@ static uint32_t *EMIT_JSR(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
     RA_SetDirtyM68kRegister(&ptr, 15);
     ptr = EMIT_ResetOffsetPC(ptr);
     *ptr++ = mov_reg(REG_PC, ea);
-    (*m68k_ptr) += ext_words;
     RA_FreeARMRegister(&ptr, ea);
-    *ptr++ = INSN_TO_LE(0xffffffff);
+
+    uint16_t *target = GetJumpTarget(opcode, *m68k_ptr);
+    uint16_t *site = *m68k_ptr - 1;
+    (*m68k_ptr) += ext_words;
+
+    /* Short subroutine at known address is inlined, RTS at its end returns here */
+    if ((uintptr_t)target != M68K_EXIT_COMPUTED && M68K_CanInlineCall(site, target))
+    {
+        M68K_PushReturnAddress(*m68k_ptr);
+        *m68k_ptr = target;
+    }
+    else
+    {
+        m68k_exit_target = target;
+        *ptr++ = INSN_TO_LE(0xffffffff);
+    }
 
     return ptr;
 }
@@ -2314,6 +2417,7 @@ static uint32_t *EMIT_JMP(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
 
     ptr = EMIT_LoadFromEffectiveAddress(ptr, 0, &ea, opcode & 0x3f, (*m68k_ptr), &ext_words, 0, NULL);
     ptr = EMIT_ResetOffsetPC(ptr);
+    m68k_exit_target = GetJumpTarget(opcode, *m68k_ptr);
     (*m68k_ptr) += ext_words;
     RA_FreeARMRegister(&ptr, ea);
     *ptr++ = INSN_TO_LE(0xffffffff);
@@ -2692,6 +2796,14 @@ static uint32_t *EMIT_LEA(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
     else
         ptr = EMIT_LoadFromEffectiveAddress(ptr, 0, &dest, opcode & 0x3f, (*m68k_ptr), &ext_words, 1, NULL);
 
+    /* Absolute and PC-relative addresses are known already at translation time */
+    if ((opcode & 0x3f) == 0x38)
+        M68K_SetConstant(8 + ((opcode >> 9) & 7), (int16_t)cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]));
+    else if ((opcode & 0x3f) == 0x39)
+        M68K_SetConstant(8 + ((opcode >> 9) & 7), cache_read_32(ICACHE, (uintptr_t)&(*m68k_ptr)[0]));
+    else if ((opcode & 0x3f) == 0x3a)
+        M68K_SetConstant(8 + ((opcode >> 9) & 7), (uint32_t)(uintptr_t)&(*m68k_ptr)[0] + (int16_t)cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[0]));
+
     (*m68k_ptr) += ext_words;
 
     ptr = EMIT_AdvancePC(ptr, 2 * (ext_words + 1));
@@ -2732,8 +2844,6 @@ static uint32_t *EMIT_CHK(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
     ptr = EMIT_AdvancePC(ptr, 2 * (ext_words + 1));
     (*m68k_ptr) += ext_words;
 
-    ptr = EMIT_FlushPC(ptr);
-
     /* Check if Dn < 0 */
     if (opcode & 0x80)
         *ptr++ = adds_reg(31, 31, dn, LSL, 16); 
@@ -2756,6 +2866,7 @@ static uint32_t *EMIT_CHK(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr, u
 
     *ptr++ = orr_immed(cc, cc, 1, 31 & (32 - SRB_N));
 
+    ptr = EMIT_MaterializePC(ptr, 0);
     ptr = EMIT_Exception(ptr, VECTOR_CHK, 2, opcode_address);
 
     RA_FreeARMRegister(&ptr, src);
@@ -766,7 +766,7 @@ uint32_t *EMIT_DBcc(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 
         *ptr++ = (uint32_t)(uintptr_t)branch_2;
         *ptr++ = 1;
-        *ptr++ = 0;
+        *ptr++ = (uint32_t)(uintptr_t)(bra_rel_ptr + 2);
         *ptr++ = INSN_TO_LE(0xfffffffe);
         *ptr++ = INSN_TO_LE(0xfffffff1);
 
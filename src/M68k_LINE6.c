@@ -15,6 +15,7 @@
 
 extern struct M68KState *__m68k_state;
 extern uint16_t * m68k_entry_point;
+extern uint16_t * m68k_exit_target;
 
 uint32_t *EMIT_BRA(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 {
@@ -100,7 +101,8 @@ uint32_t *EMIT_BRA(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     int32_t var_EMU68_BRANCH_INLINE_DISTANCE = (__m68k_state->JIT_CONTROL >> JCCB_INLINE_RANGE) & JCCB_INLINE_RANGE_MASK;
 
     /* If branch is done within +- 4KB, try to inline it instead of breaking up the translation unit */
-    if ((uintptr_t)*m68k_ptr >= 0x01000000 && (bra_off >= -var_EMU68_BRANCH_INLINE_DISTANCE && bra_off <= var_EMU68_BRANCH_INLINE_DISTANCE)) {
+    if (((uintptr_t)*m68k_ptr >= 0x01000000 && (bra_off >= -var_EMU68_BRANCH_INLINE_DISTANCE && bra_off <= var_EMU68_BRANCH_INLINE_DISTANCE)) ||
+        (bsr && M68K_CanInlineCall(bra_rel_ptr - 1, (uint16_t *)((uintptr_t)bra_rel_ptr + bra_off)))) {
         if (bsr) {
             M68K_PushReturnAddress(*m68k_ptr);
         }
@@ -108,7 +110,11 @@ uint32_t *EMIT_BRA(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
         *m68k_ptr = (void *)((uintptr_t)bra_rel_ptr + bra_off);
     }
     else
+    {
+        /* Target of the branch is constant, allow the translator to chain the exit */
+        m68k_exit_target = (void *)((uintptr_t)bra_rel_ptr + bra_off);
         *ptr++ = INSN_TO_LE(0xffffffff);
+    }
 
     return ptr;
 }
@@ -120,10 +126,14 @@ uint32_t *EMIT_Bcc(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     uint32_t *tmpptr;
     uint32_t *distance_ptr;
     uint8_t m68k_condition = (opcode >> 8) & 15;
+    uint16_t *bcc_pc = *m68k_ptr - 1;
     intptr_t branch_target = (intptr_t)(*m68k_ptr);
     intptr_t branch_offset = 0;
     int8_t local_pc_off = 2;
     int take_branch = 1;
+    struct M68KIRInsn *ir = M68K_IRCurrent();
+    int host_flags = ir && (ir->ir_Flags & IRF_FLAGS_IN) && EMIT_HasHostFlags(ptr);
+    uint8_t host_condition = 0xff;
 
     ptr = EMIT_GetOffsetPC(ptr, &local_pc_off);
     ptr = EMIT_ResetOffsetPC(ptr);
@@ -154,6 +164,9 @@ uint32_t *EMIT_Bcc(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     (void)take_branch;
     (void)tmpptr;
     (void)distance_ptr;
+    (void)host_flags;
+    (void)host_condition;
+    (void)bcc_pc;
     
     uint8_t success_condition = EMIT_TestCondition(&ptr, m68k_condition);
     uint8_t pc_yes = RA_AllocARMRegister(&ptr);
@@ -233,17 +246,35 @@ uint32_t *EMIT_Bcc(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 #endif
 #endif
 
+    /* Second tier follows the direction in which the first tier unit was left most of the time */
+    if (M68K_IsHotExit(bcc_pc))
+        take_branch = !take_branch;
+
     if (!take_branch)
     {
         m68k_condition ^= 1;
     }
 
-    /* Force getting CC in place */
-    RA_GetCC(&ptr);
+    /* Flags of preceding compare are still in NZCV, use them instead of CC register */
+    if (host_flags)
+        host_condition = EMIT_HostCondition(m68k_condition);
 
     /* Prepare fake jump on condition, assume def branch is taken */
-    tmpptr = ptr;
-    ptr = EMIT_JumpOnCondition(ptr, m68k_condition, 0);
+    if (host_condition != 0xff)
+    {
+        host_flags_branches++;
+
+        tmpptr = ptr;
+        *ptr++ = b_cc(host_condition, 0);
+    }
+    else
+    {
+        /* Force getting CC in place */
+        RA_GetCC(&ptr);
+
+        tmpptr = ptr;
+        ptr = EMIT_JumpOnCondition(ptr, m68k_condition, 0);
+    }
     distance_ptr = ptr;
 
     /* Insert the first case here */
@@ -292,11 +323,19 @@ uint32_t *EMIT_Bcc(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
         }
     }
 
-    /* Insert local exit */
-    ptr = EMIT_LocalExit(ptr, 1);
+    ptr = EMIT_CountExit(ptr, bcc_pc);
+
+    /* Insert local exit. Both paths of the branch are known, so the exit can be chained */
+    if (take_branch)
+        ptr = EMIT_ChainedLocalExit(ptr, 1, *m68k_ptr);
+    else
+        ptr = EMIT_ChainedLocalExit(ptr, 1, (uint16_t *)branch_target);
 
     /* Fixup jump on condition */
-    EMIT_JumpOnCondition(tmpptr, m68k_condition, 1 + ptr - distance_ptr);
+    if (host_condition != 0xff)
+        *tmpptr = b_cc(host_condition, 1 + ptr - distance_ptr);
+    else
+        EMIT_JumpOnCondition(tmpptr, m68k_condition, 1 + ptr - distance_ptr);
 
     /* Insert the second case here */
     if (!take_branch)
@@ -57,6 +57,8 @@ static uint32_t *EMIT_CMPA_ext(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_p
         }
     }
 
+    EMIT_SetHostFlags(ptr, 1);
+
     return ptr;
 }
 
@@ -175,6 +177,8 @@ static uint32_t *EMIT_CMP_ext(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_pt
         }
     }
 
+    EMIT_SetHostFlags(ptr, 1);
+
     return ptr;
 }
 
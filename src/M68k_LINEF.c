@@ -478,7 +478,7 @@ int FPSR_Update_Needed(uint16_t *ptr, int level)
 {
     int cnt = 0;
 
-    while((cache_read_16(ICACHE, (uintptr_t)ptr) & 0xfe00) != 0xf200)
+    while(M68K_InCodeWindow(ptr) && (cache_read_16(ICACHE, (uintptr_t)ptr) & 0xfe00) != 0xf200)
     {
         if (cnt++ > 15)
             return 1;
@@ -491,6 +491,9 @@ int FPSR_Update_Needed(uint16_t *ptr, int level)
         ptr += len;
     }
 
+    if (!M68K_InCodeWindow(ptr))
+        return 1;
+
     uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&ptr[0]);
     uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&ptr[1]);
 
@@ -1792,18 +1795,44 @@ void __clear_cache(void *begin, void *end);
 #define MAX_EPILOGUE_LENGTH 256
 uint32_t icache_epilogue[MAX_EPILOGUE_LENGTH];
 
+/* Flush single unit, either weak (if enabled) or by discarding it */
+static void FlushUnit(struct M68KTranslationUnit *u)
+{
+    extern struct M68KState *__m68k_state;
+
+    // Nothing was written to write protected pages since the unit was translated
+    if (M68K_UnitProtected(u))
+        return;
+
+    if (__m68k_state->JIT_CONTROL & JCCF_SOFT)
+    {
+        // Weak cflush. Generate invalid entry address instead of flushing. Fault handler will
+        // verify block checksum and eventually discard it
+        M68K_SoftFlushUnit(u);
+    }
+    else
+    {
+        // kprintf("[LINEF] Unit %p, %08x-%08x match! Removing.\n", u, u->mt_M68kLow, u->mt_M68kHigh);
+        M68K_ReleaseUnit(u);
+    }
+}
+
 void *invalidate_instruction_cache(uintptr_t target_addr, uint16_t *pc, uint32_t *arm_pc)
 {
     int i;
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&pc[0]);
+    uint16_t opcode;
     struct M68KTranslationUnit *u;
-    struct Node *n, *next;
+    struct Node *n;
     extern struct List LRU;
     extern void *jit_tlsf;
     extern struct M68KState *__m68k_state;
 
     (void)jit_tlsf;
 
+    M68K_LockJIT();
+
+    opcode = cache_read_16(ICACHE, (uintptr_t)&pc[0]);
+
     //kprintf("[LINEF] ICache flush... Opcode=%04x, Target=%08x, PC=%08x, ARM PC=%p\n", opcode, target_addr, pc, arm_pc);
     // kprintf("[LINEF] ARM insn: %08x\n", *arm_pc);
 
@@ -1829,68 +1858,12 @@ void *invalidate_instruction_cache(uintptr_t target_addr, uint16_t *pc, uint32_t
     switch (opcode & 0x18) {
         case 0x08:  /* Line */
             // kprintf("[LINEF] Invalidating line\n");
-            ForeachNodeSafe(&LRU, n, next)
-            {
-                u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
-
-                // If highest address of unit is lower than the begin flushed area, or lowest address of unit higher than the flushed area end
-                // then skip the unit
-                if ((uintptr_t)u->mt_M68kLow > ((target_addr + 16) & ~15) || (uintptr_t)u->mt_M68kHigh < (target_addr & ~15))
-                    continue;
-
-                if (__m68k_state->JIT_CONTROL & JCCF_SOFT)
-                {
-                    // Weak cflush. Generate invalid entry address instead of flushing. Fault handler will
-                    // verify block checksum and eventually discard it
-                    uintptr_t e = (uintptr_t)u->mt_ARMEntryPoint;
-                    e &= 0x00ffffffffffffffULL;
-                    e |= 0xaa00000000000000ULL;
-                    u->mt_ARMEntryPoint = (void*)e;
-                }
-                else
-                {
-                    // kprintf("[LINEF] Unit %p, %08x-%08x match! Removing.\n", u, u->mt_M68kLow, u->mt_M68kHigh);
-                    REMOVE(&u->mt_LRUNode);
-                    REMOVE(&u->mt_HashNode);
-                    tlsf_free(jit_tlsf, u);
-
-                    __m68k_state->JIT_UNIT_COUNT--;
-                    __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
-                }
-            }
+            // Only the units covering the flushed line are found through the page map
+            M68K_ForEachUnitInRange(target_addr & ~15, (target_addr + 16) & ~15, FlushUnit);
             break;
         case 0x10:  /* Page */
             // kprintf("[LINEF] Invalidating page\n");
-            ForeachNodeSafe(&LRU, n, next)
-            {
-                u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
-
-                // If highest address of unit is lower than the begin flushed area, or lowest address of unit higher than the flushed area end
-                // then skip the unit
-                if ((uintptr_t)u->mt_M68kLow > ((target_addr + 4096) & ~4095) || (uintptr_t)u->mt_M68kHigh < (target_addr & ~4095))
-                    continue;
-
-                // kprintf("[LINEF] Unit %p, %08x-%08x match! Removing.\n", u, u->mt_M68kLow, u->mt_M68kHigh);
-
-                if (__m68k_state->JIT_CONTROL & JCCF_SOFT)
-                {
-                    // Weak cflush. Generate invalid entry address instead of flushing. Fault handler will
-                    // verify block checksum and eventually discard it
-                    uintptr_t e = (uintptr_t)u->mt_ARMEntryPoint;
-                    e &= 0x00ffffffffffffffULL;
-                    e |= 0xaa00000000000000ULL;
-                    u->mt_ARMEntryPoint = (void*)e;
-                }
-                else
-                {
-                    REMOVE(&u->mt_LRUNode);
-                    REMOVE(&u->mt_HashNode);
-                    tlsf_free(jit_tlsf, u);
-
-                    __m68k_state->JIT_UNIT_COUNT--;
-                    __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
-                }
-            }
+            M68K_ForEachUnitInRange(target_addr & ~4095, (target_addr + 4096) & ~4095, FlushUnit);
             break;
         case 0x18:  /* All */
             // kprintf("[LINEF] Invalidating all\n");            
@@ -1900,12 +1873,14 @@ void *invalidate_instruction_cache(uintptr_t target_addr, uint16_t *pc, uint32_t
                 {
                     ForeachNode(&LRU, n)
                     {
-                        uintptr_t uptr = ((uintptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
-                        uptr += __builtin_offsetof(struct M68KTranslationUnit, mt_ARMEntryPoint);
+                        u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+
+                        if (M68K_UnitProtected(u))
+                            continue;
 
                         // Weak cflush. Generate invalid entry address instead of flushing. Fault handler will
                         // verify block checksum and eventually discard it
-                        *(uint8_t *)uptr = 0xaa;
+                        M68K_SoftFlushUnit(u);
                     }
                 }
                 else
@@ -1914,43 +1889,43 @@ void *invalidate_instruction_cache(uintptr_t target_addr, uint16_t *pc, uint32_t
 #if EMU68_WEAK_CFLUSH_SLOW
                             __m68k_state->JIT_UNIT_COUNT >= __m68k_state->JIT_SOFTFLUSH_THRESH &&
 #endif
-                            (n = REMHEAD(&LRU)))
+                            (n = GetHead(&LRU)))
                     {
                         u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
              
-                        REMOVE(&u->mt_HashNode);
-                        tlsf_free(jit_tlsf, u);
-                        
-                        __m68k_state->JIT_UNIT_COUNT--;
+                        M68K_ReleaseUnit(u);
                     }
-                    __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
 #if EMU68_WEAK_CFLUSH_SLOW
                     ForeachNode(&LRU, n)
                     {
-                        uintptr_t uptr = ((uintptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
-                        uptr += __builtin_offsetof(struct M68KTranslationUnit, mt_ARMEntryPoint);
+                        u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
 
                         // Weak cflush. Generate invalid entry address instead of flushing. Fault handler will
                         // verify block checksum and eventually discard it
-                        *(uint8_t *)uptr = 0xaa;
+                        M68K_SoftFlushUnit(u);
                     }
 #endif
                 }
             }
             else
             {
-                while ((n = REMHEAD(&LRU))) {
+                struct Node *next;
+
+                ForeachNodeSafe(&LRU, n, next) {
                     u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+
+                    if (M68K_UnitProtected(u))
+                        continue;
+
                     // kprintf("[LINEF] Removing unit %p\n", u);                
-                    REMOVE(&u->mt_HashNode);
-                    tlsf_free(jit_tlsf, u);
+                    M68K_ReleaseUnit(u);
                 }
-                __m68k_state->JIT_UNIT_COUNT = 0;
-                __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
             }
             break;
     }
 
+    M68K_UnlockJIT();
+
     return &icache_epilogue[0];
 }
 
@@ -2329,21 +2304,27 @@ uint32_t *EMIT_FPU(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
 #endif
 #endif
 
+        /* Local exit leaves with the PC of branch path which is not translated inline */
+        uint32_t exit_target = branch_target;
 #if EMU68_DEF_BRANCH_AUTO
         if(
             branch_target < (intptr_t)*m68k_ptr &&
             ((intptr_t)*m68k_ptr - branch_target) < EMU68_DEF_BRANCH_AUTO_RANGE
         )
+        {
+            exit_target = (uint32_t)(uintptr_t)*m68k_ptr;
             *m68k_ptr = (uint16_t *)branch_target;
+        }
 #else
 #if EMU68_DEF_BRANCH_TAKEN
+        exit_target = (uint32_t)(uintptr_t)*m68k_ptr;
         *m68k_ptr = (uint16_t *)branch_target;
 #endif
 #endif
         RA_FreeARMRegister(&ptr, reg);
         *ptr++ = (uint32_t)(uintptr_t)tmpptr;
         *ptr++ = 1;
-        *ptr++ = branch_target;
+        *ptr++ = exit_target;
         *ptr++ = INSN_TO_LE(0xfffffffe);
     }
     /* FCMP */
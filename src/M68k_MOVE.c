@@ -321,6 +321,119 @@ uint32_t *EMIT_move(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
                 }
             }
         }
+
+        // Is move.l Reg, (An) or move.l Reg, d16(An) ?: Dest mode 010 or 101, source mode 000 or 001
+        else if ((opcode & 0x01f0) == 0x0080 || (opcode & 0x01f0) == 0x0140)
+        {
+            int len1 = (opcode & 0x01c0) == 0x0140 ? 2 : 1;
+            int16_t off1 = len1 == 2 ? (int16_t)cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[1]) : 0;
+
+            opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[len1]);
+
+            // Candidate found. Is next opcode a store of register to the same An, at adjacent address?
+            if (
+                (opcode2 & 0xf000) == 0x2000 &&                                     // move.l
+                ((opcode2 & 0x01f0) == 0x0080 || (opcode2 & 0x01f0) == 0x0140) &&   // same kind
+                (opcode2 & 0x0e00) == (opcode & 0x0e00)                             // same dest reg
+            )
+            {
+                int len2 = (opcode2 & 0x01c0) == 0x0140 ? 2 : 1;
+                int16_t off2 = len2 == 2 ? (int16_t)cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[len1 + 1]) : 0;
+
+                /*
+                    Both longwords have to be adjacent and within reach of stp. The second one has to be
+                    at higher address, a pair hitting emulated memory is written in ascending order.
+                */
+                if (off2 - off1 == 4 && (off1 & 3) == 0 && off1 >= -256 && off1 <= 252)
+                {
+                    uint8_t addr_reg = RA_MapM68kRegister(&ptr, ((opcode >> 9) & 7) + 8);
+                    uint8_t src_reg_1 = RA_MapM68kRegister(&ptr, opcode & 0xf);
+                    uint8_t src_reg_2 = RA_MapM68kRegister(&ptr, opcode2 & 0xf);
+
+                    /* Two subsequent register moves to adjacent locations */
+                    (*m68k_ptr) += len1;
+                    update_mask = M68K_GetSRMask(*m68k_ptr);
+                    (*m68k_ptr) += len2;
+
+                    if (update_mask)
+                    {
+                        *ptr++ = cmn_reg(31, src_reg_2, LSL, 0);
+                    }
+
+                    *ptr++ = stp(addr_reg, src_reg_1, src_reg_2, off1);
+
+                    tmp_reg = src_reg_2;
+
+                    done = 1;
+                    ptr = EMIT_AdvancePC(ptr, 2 * (len1 + len2));
+                    *insn_consumed = 2;
+                    size = 4;
+                }
+            }
+        }
+
+        // Is move.l (An), Reg or move.l d16(An), Reg ?: Dest mode 001 or 000, source mode 010 or 101
+        else if ((opcode & 0x01b8) == 0x0010 || (opcode & 0x01b8) == 0x0028)
+        {
+            int len1 = (opcode & 0x0038) == 0x0028 ? 2 : 1;
+            int16_t off1 = len1 == 2 ? (int16_t)cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[1]) : 0;
+
+            opcode2 = cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[len1]);
+
+            // Candidate found. Is next opcode a load from the same An, at adjacent address?
+            if (
+                (opcode2 & 0xf000) == 0x2000 &&                                     // move.l
+                ((opcode2 & 0x01b8) == 0x0010 || (opcode2 & 0x01b8) == 0x0028) &&   // same kind
+                (opcode2 & 7) == (opcode & 7) &&                                    // same src reg
+                (opcode2 & 0x0e40) != (opcode & 0x0e40)                             // Two different dest registers!
+            )
+            {
+                int len2 = (opcode2 & 0x0038) == 0x0028 ? 2 : 1;
+                int16_t off2 = len2 == 2 ? (int16_t)cache_read_16(ICACHE, (uintptr_t)&(*m68k_ptr)[len1 + 1]) : 0;
+                uint8_t dst_1 = ((opcode >> 9) & 0x7) + ((opcode >> 3) & 8);
+                uint8_t dst_2 = ((opcode2 >> 9) & 0x7) + ((opcode2 >> 3) & 8);
+
+                /*
+                    Both longwords have to be adjacent and within reach of ldp. The second one has to be
+                    at higher address, a pair hitting emulated memory is read in ascending order. The
+                    address register cannot be loaded, the second access would use its new value.
+                */
+                if (off2 - off1 == 4 && (off1 & 3) == 0 && off1 >= -256 && off1 <= 252 &&
+                    dst_1 != 8 + (opcode & 7) && dst_2 != 8 + (opcode & 7))
+                {
+                    uint8_t addr_reg = RA_MapM68kRegister(&ptr, (opcode & 7) + 8);
+                    uint8_t dst_reg_1 = RA_MapM68kRegisterForWrite(&ptr, dst_1);
+                    uint8_t dst_reg_2 = RA_MapM68kRegisterForWrite(&ptr, dst_2);
+                    uint8_t is_movea2 = (opcode2 & 0x01c0) == 0x0040;
+
+                    /* Two subsequent register loads from adjacent locations */
+                    (*m68k_ptr) += len1 + len2;
+
+                    *ptr++ = ldp(addr_reg, dst_reg_1, dst_reg_2, off1);
+
+                    if (!is_movea2) {
+                        update_mask = M68K_GetSRMask(*m68k_ptr - len2);
+                        if (update_mask) {
+                            *ptr++ = cmn_reg(31, dst_reg_2, LSL, 0);
+                            tmp_reg = dst_reg_2;
+                        }
+                    }
+                    else if (!is_movea) {
+                        if (update_mask) {
+                            *ptr++ = cmn_reg(31, dst_reg_1, LSL, 0);
+                            tmp_reg = dst_reg_1;
+                        }
+                    }
+
+                    is_movea = is_movea && is_movea2;
+
+                    done = 1;
+                    ptr = EMIT_AdvancePC(ptr, 2 * (len1 + len2));
+                    *insn_consumed = 2;
+                    size = 4;
+                }
+            }
+        }
     }
 
     if (!done)
@@ -435,6 +548,15 @@ uint32_t *EMIT_move(uint32_t *ptr, uint16_t **m68k_ptr, uint16_t *insn_consumed)
             }
         }
 
+        /* Immediate loaded into a register is known till the register is written again */
+        if (is_load_immediate && !fused_opcodes && (tmp & 0x30) == 0)
+        {
+            if (is_movea)
+                M68K_SetConstant(8 + (tmp & 7), size == 2 ? (uint32_t)(int16_t)immediate_value : immediate_value);
+            else if (size == 4)
+                M68K_SetConstant(tmp & 7, immediate_value);
+        }
+
         /* In case of movea the value is *always* sign-extended to 32 bits */
         if (is_movea && size == 2) {
             size = 4;
@@ -202,7 +202,6 @@ uint32_t *EMIT_DIVS_W(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
     uint8_t ext_words = 0;
 
     ptr = EMIT_LoadFromEffectiveAddress(ptr, 0x80 | 2, &reg_q, opcode & 0x3f, *m68k_ptr, &ext_words, 0, NULL);
-    ptr = EMIT_FlushPC(ptr);
     RA_GetCC(&ptr);
 
     *ptr++ = ands_immed(31, reg_q, 16, 0);
@@ -214,7 +213,7 @@ uint32_t *EMIT_DIVS_W(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
         /*
             This is a point of no return. Issue division by zero exception here
         */
-        *ptr++ = add_immed(REG_PC, REG_PC, 2 * (ext_words + 1));
+        ptr = EMIT_MaterializePC(ptr, 2 * (ext_words + 1));
 
         ptr = EMIT_Exception(ptr, VECTOR_DIVIDE_BY_ZERO, 2, (uint32_t)(intptr_t)(*m68k_ptr - 1));
 
@@ -312,7 +311,6 @@ uint32_t *EMIT_DIVU_W(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 
     /* Promise read only here. If dealing with Dn in EA, it will be extended below */
     ptr = EMIT_LoadFromEffectiveAddress(ptr, 2, &reg_q, opcode & 0x3f, *m68k_ptr, &ext_words, 1, NULL);
-    ptr = EMIT_FlushPC(ptr);
     RA_GetCC(&ptr);
 
     *ptr++ = ands_immed(31, reg_q, 16, 0);
@@ -324,7 +322,7 @@ uint32_t *EMIT_DIVU_W(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
         /*
             This is a point of no return. Issue division by zero exception here
         */
-        *ptr++ = add_immed(REG_PC, REG_PC, 2 * (ext_words + 1));
+        ptr = EMIT_MaterializePC(ptr, 2 * (ext_words + 1));
 
         ptr = EMIT_Exception(ptr, VECTOR_DIVIDE_BY_ZERO, 2, (uint32_t)(intptr_t)(*m68k_ptr - 1));
 
@@ -433,7 +431,6 @@ uint32_t *EMIT_DIVUS_L(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
 
     // Load divisor
     ptr = EMIT_LoadFromEffectiveAddress(ptr, 4, &reg_q, opcode & 0x3f, *m68k_ptr, &ext_words, 1, NULL);
-    ptr = EMIT_FlushPC(ptr);
     RA_GetCC(&ptr);
 
     // Check if division by 0
@@ -445,7 +442,7 @@ uint32_t *EMIT_DIVUS_L(uint32_t *ptr, uint16_t opcode, uint16_t **m68k_ptr)
         /*
             This is a point of no return. Issue division by zero exception here
         */
-        *ptr++ = add_immed(REG_PC, REG_PC, 2 * (ext_words + 1));
+        ptr = EMIT_MaterializePC(ptr, 2 * (ext_words + 1));
 
         ptr = EMIT_Exception(ptr, VECTOR_DIVIDE_BY_ZERO, 2, (uint32_t)(intptr_t)(*m68k_ptr - 1));
 
@@ -0,0 +1,245 @@
+/*
+    Copyright © 2019 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include "config.h"
+#include "support.h"
+#include "M68k.h"
+#include "A64.h"
+
+/*
+    Sampling profiler of translated code. PMU event counter 0 counts CPU cycles and raises an
+    overflow interrupt every PROF_PERIOD cycles. The IRQ handler passes interrupted ARM PC to
+    M68K_ProfileSample, which attributes the sample to the JIT unit being executed. Samples are
+    accumulated per m68k entry address in a table independent of the JIT cache, so that they
+    survive flushes and evictions of the units.
+*/
+
+extern struct M68KState *__m68k_state;
+
+struct ProfileEntry {
+    uint32_t    pe_M68kAddress;     /* Entry point of the unit */
+    uint32_t    pe_M68kLow;         /* Lowest m68k address covered by the unit */
+    uint32_t    pe_M68kHigh;        /* Highest m68k address covered by the unit */
+    uint32_t    pe_Samples;         /* Number of samples, zero if the entry is free */
+};
+
+static struct ProfileEntry prof_table[EMU68_PROFILE_SIZE];
+static uint32_t prof_used;
+static uint32_t prof_host;          /* Samples taken outside of JIT code (dispatcher, translator, handlers) */
+static uint32_t prof_unknown;       /* Samples in JIT code which could not be assigned to any unit */
+static uint32_t prof_dropped;       /* Samples lost because the table was full */
+
+#define JIT_EXEC_BASE   0xfffffff000000000ULL
+#define JIT_EXEC_SIZE   ((uint64_t)KERNEL_JIT_PAGES << 21)
+
+/* The sample handler runs asynchronously within JIT code, it may not touch any SIMD register */
+#ifdef __aarch64__
+#define PROF_IRQ_SAFE __attribute__((target("general-regs-only")))
+#else
+#define PROF_IRQ_SAFE
+#endif
+
+static inline uint32_t ProfileHash(uint32_t pc)
+{
+    return ((pc ^ (pc >> 16)) >> 1) & (EMU68_PROFILE_SIZE - 1);
+}
+
+static void ProfileReset()
+{
+    for (int i=0; i < EMU68_PROFILE_SIZE; i++)
+    {
+        prof_table[i].pe_Samples = 0;
+    }
+
+    prof_used = 0;
+    prof_host = 0;
+    prof_unknown = 0;
+    prof_dropped = 0;
+    __m68k_state->PROF_SAMPLES = 0;
+}
+
+/* Returns unit which was found by m68k address if the arm_pc lies within its code */
+static inline PROF_IRQ_SAFE struct M68KTranslationUnit *ProfileCheckUnit(uint32_t m68k_pc, uintptr_t arm_pc)
+{
+    void *entry = M68K_LookupEntryPoint(m68k_pc);
+
+    if (entry != NULL)
+    {
+        struct M68KTranslationUnit *unit = M68K_UnitFromEntry(entry);
+        uintptr_t start = (uintptr_t)&unit->mt_ARMCode[0] | 0x0000001000000000ULL;
+
+        if (arm_pc >= start && arm_pc < start + 4 * unit->mt_ARMInsnCnt)
+            return unit;
+    }
+
+    return NULL;
+}
+
+/*
+    Called from the IRQ handler on PMU overflow. The unit is found through the m68k PC of last
+    dispatched unit (TPIDR_EL1) or, if the unit was entered through a direct link, through the
+    current m68k PC which is exact on entry of every unit.
+*/
+void PROF_IRQ_SAFE M68K_ProfileSample(uintptr_t arm_pc, uint64_t *regs)
+{
+    struct M68KState *ctx = __m68k_state;
+    struct M68KTranslationUnit *unit = NULL;
+    uint64_t last_pc;
+
+    asm volatile("msr PMOVSCLR_EL0, %0"::"r"(1ULL));
+    asm volatile("msr PMEVCNTR0_EL0, %0; isb"::"r"((uint64_t)(uint32_t)-ctx->PROF_PERIOD));
+
+    ctx->PROF_SAMPLES++;
+
+    if (arm_pc - JIT_EXEC_BASE >= JIT_EXEC_SIZE)
+    {
+        prof_host++;
+        return;
+    }
+
+    asm volatile("mrs %0, TPIDR_EL1":"=r"(last_pc));
+
+    unit = ProfileCheckUnit((uint32_t)last_pc, arm_pc);
+    if (unit == NULL)
+        unit = ProfileCheckUnit((uint32_t)regs[REG_PC], arm_pc);
+
+    if (unit == NULL)
+    {
+        prof_unknown++;
+        return;
+    }
+
+    uint32_t pc = (uint32_t)(uintptr_t)unit->mt_M68kAddress;
+    uint32_t idx = ProfileHash(pc);
+
+    while (prof_table[idx].pe_Samples != 0 && prof_table[idx].pe_M68kAddress != pc)
+        idx = (idx + 1) & (EMU68_PROFILE_SIZE - 1);
+
+    if (prof_table[idx].pe_Samples == 0)
+    {
+        if (prof_used >= (EMU68_PROFILE_SIZE * 3) / 4)
+        {
+            prof_dropped++;
+            return;
+        }
+
+        prof_used++;
+        prof_table[idx].pe_M68kAddress = pc;
+        prof_table[idx].pe_M68kLow = (uint32_t)(uintptr_t)unit->mt_M68kLow;
+        prof_table[idx].pe_M68kHigh = (uint32_t)(uintptr_t)unit->mt_M68kHigh;
+    }
+
+    prof_table[idx].pe_Samples++;
+}
+
+/*
+    Start (period != 0) or stop (period == 0) the profiler. Starting the profiler discards all
+    previously collected samples. Period is given in CPU cycles.
+*/
+void M68K_ProfileControl(uint32_t period)
+{
+    struct M68KState *ctx = __m68k_state;
+
+    /* Stop sampling first */
+    asm volatile("msr PMINTENCLR_EL1, %0"::"r"(1ULL));
+    asm volatile("msr PMCNTENCLR_EL0, %0"::"r"(1ULL));
+    asm volatile("msr PMOVSCLR_EL0, %0; isb"::"r"(1ULL));
+
+    if (period != 0)
+    {
+        if (period < EMU68_PROFILE_MIN_PERIOD)
+            period = EMU68_PROFILE_MIN_PERIOD;
+
+        ProfileReset();
+        ctx->PROF_PERIOD = period;
+
+        /* Count CPU cycles (event 0x11) on counter 0 */
+        asm volatile("msr PMEVTYPER0_EL0, %0"::"r"(0x11ULL));
+        asm volatile("msr PMEVCNTR0_EL0, %0"::"r"((uint64_t)(uint32_t)-period));
+        asm volatile("msr PMINTENSET_EL1, %0"::"r"(1ULL));
+        asm volatile("msr PMCNTENSET_EL0, %0; isb"::"r"(1ULL));
+    }
+    else
+    {
+        ctx->PROF_PERIOD = 0;
+    }
+}
+
+/*
+    Build the top-N list of units with highest sample count and print it on the console. If buffer
+    is not zero, the report is stored there too. On input the first longword of the buffer holds the
+    maximal number of entries it can take. Layout of the report:
+
+        +0  number of entries stored
+        +4  total number of samples
+        +8  samples taken outside of JIT code
+        +12 samples in JIT code not assigned to any unit
+        +16 entries, 16 bytes each: entry address, lowest address, highest address, samples
+*/
+void M68K_ProfileReport(uint32_t buffer)
+{
+    struct ProfileEntry *top[EMU68_PROFILE_TOP];
+    uint32_t *out = (uint32_t *)(uintptr_t)buffer;
+    uint32_t total = __m68k_state->PROF_SAMPLES;
+    uint32_t max = EMU68_PROFILE_TOP;
+    int count = 0;
+
+    if (out != NULL && out[0] < max)
+        max = out[0];
+
+    for (int i=0; i < EMU68_PROFILE_SIZE; i++)
+    {
+        struct ProfileEntry *e = &prof_table[i];
+        int pos;
+
+        if (e->pe_Samples == 0)
+            continue;
+
+        /* Insert the entry into sorted top list */
+        for (pos = count; pos > 0 && top[pos - 1]->pe_Samples < e->pe_Samples; pos--)
+        {
+            if (pos < (int)max)
+                top[pos] = top[pos - 1];
+        }
+
+        if (pos < (int)max)
+        {
+            top[pos] = e;
+            if (count < (int)max)
+                count++;
+        }
+    }
+
+    kprintf("[PROF] %d samples, %d outside JIT, %d unassigned, %d dropped, %d units\n",
+        total, prof_host, prof_unknown, prof_dropped, prof_used);
+
+    for (int i=0; i < count; i++)
+    {
+        kprintf("[PROF] %2d: %08x (%08x-%08x) %6d samples, %d%%\n", i, top[i]->pe_M68kAddress,
+            top[i]->pe_M68kLow, top[i]->pe_M68kHigh, top[i]->pe_Samples,
+            total ? (100 * top[i]->pe_Samples) / total : 0);
+    }
+
+    if (out != NULL)
+    {
+        out[0] = count;
+        out[1] = total;
+        out[2] = prof_host;
+        out[3] = prof_unknown;
+
+        for (int i=0; i < count; i++)
+        {
+            out[4 + 4*i] = top[i]->pe_M68kAddress;
+            out[5 + 4*i] = top[i]->pe_M68kLow;
+            out[6 + 4*i] = top[i]->pe_M68kHigh;
+            out[7 + 4*i] = top[i]->pe_Samples;
+        }
+    }
+}
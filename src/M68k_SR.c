@@ -858,211 +858,172 @@ static SR_Check SRCheck[16] = {
 
 extern struct M68KState *__m68k_state;
 
-/* Get the mask of status flags changed by the instruction specified by the opcode */
-uint8_t M68K_GetSRMask(uint16_t *insn_stream)
-{
-    uint16_t opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)insn_stream);
-    int scan_depth = 0;
-    const int max_scan_depth = (__m68k_state->JIT_CONTROL2 >> JC2B_CCR_SCAN_DEPTH) & JC2_CCR_SCAN_MASK;
-    uint8_t mask = 0;
-    uint8_t needed = 0;
-    uint8_t tmp_sets = 0;
-    uint8_t tmp_needs = 0;
-
-    D(kprintf("[JIT] GetSRMask, opcode %04x @ %08x, ", opcode, insn_stream));
-
-    uint32_t flags = SRCheck[opcode >> 12](opcode);
-    mask = flags & 0x1f;
-    tmp_sets = flags & 0x1f;
-    tmp_needs = (flags >> 16) & 0x1f;
-
-    D(kprintf(" SRNeeds = %x, SRSets = %x\n", tmp_needs, tmp_sets));
-
-    /*
-        Check as long as there are still some flags to be set by the opcode and the depth
-        of scan is not exceeded
-    */
-    while(mask != 0 && scan_depth < max_scan_depth)
-    {      
-        /* Increase scan depth level */
-        scan_depth++;
-
-        /* If instruction is a branch break the scan */
-        if (M68K_IsBranch(insn_stream))
-        {
-            /* Check if BRA/BSR and follow if possible */
-            if ((opcode & 0xfe00) == 0x6000)
-            {
-                int32_t branch_offset = (int8_t)(opcode & 0xff);
-
-                if ((opcode & 0xff) == 0) {
-                    branch_offset = (int16_t)cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
-                } else if ((opcode & 0xff) == 0xff) {
-                    uint16_t lo16, hi16;
-                    hi16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
-                    lo16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[2]);
-                    branch_offset = lo16 | (hi16 << 16);
-                }
-
-                insn_stream = insn_stream + 1 + (branch_offset >> 1);
-
-                D(kprintf("[JIT]   %02d: PC-relative jump by %d bytes to %08x\n", scan_depth, branch_offset, insn_stream));
-            }
-            /* Check if JMP/JSR and follow if possible */
-            else if ((opcode & 0xffbe) == 0x4eb8)
-            {
-                if (opcode & 1) {
-                    uint16_t lo16, hi16;
-                    hi16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
-                    lo16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[2]);
-                    insn_stream = (uint16_t*)(uintptr_t)(lo16 | (hi16 << 16));
-                } else {
-                    insn_stream = (uint16_t*)(uintptr_t)((uint32_t)cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]));
-                }
-
-                D(kprintf("[JIT]   %02d: Absolute jump to %08x\n", scan_depth, insn_stream));
-            }
-            else if ((opcode & 0xf000) == 0x6000)
-            {
-                int32_t branch_offset = (int8_t)(opcode & 0xff);
-                uint16_t *insn_stream_2 = insn_stream + 1;
-
-                // Mark the flags which conditional jump needs by itself
-                needed |= mask & (SRCheck[opcode >> 12](opcode) >> 16);
-
-                if ((opcode & 0xff) == 0) {
-                    branch_offset = (int16_t)cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
-                    insn_stream_2++;
-                } else if ((opcode & 0xff) == 0xff) {
-                    uint16_t lo16, hi16;
-                    hi16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
-                    lo16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[2]);
-                    branch_offset = lo16 | (hi16 << 16);
-                    insn_stream_2+=2;
-                }
-
-                insn_stream = insn_stream + 1 + (branch_offset >> 1);
+/*
+    Liveness of condition codes. Flags live at entry to an instruction are the flags it needs
+    itself plus the flags live at entry to its successors which it does not set. The analysis
+    walks backwards from the end of the scan window (given by JC2B_CCR_SCAN_DEPTH), where all
+    flags are assumed live. Results are memoized per translation, so that every instruction of
+    the unit is analyzed once instead of once for each scan reaching it.
+*/
+#define SR_LIVE_CACHE_SIZE  512
+#define SR_LIVE_PENDING     0x80
 
-                D(kprintf("[JIT]   %02d: Splitting into two paths %08x and %08x\n", scan_depth, insn_stream, insn_stream_2));
+struct SRLiveEntry {
+    uint32_t    addr;
+    uint16_t    gen;
+    uint8_t     live;
+};
 
-                uint8_t mask1 = mask;
-                uint8_t mask2 = mask;
-                uint8_t needed1 = needed;
-                uint8_t needed2 = needed;
-                int scan_depth_tmp = scan_depth;
+static struct SRLiveEntry sr_live_cache[SR_LIVE_CACHE_SIZE];
+static uint16_t sr_live_gen = 1;
+static int sr_max_depth;
 
-                while(mask1 && scan_depth < max_scan_depth)
-                {
-                    scan_depth++;
+/* Forget all results, code in memory may have changed since previous translation */
+void M68K_ResetSRLiveness()
+{
+    if (++sr_live_gen == 0)
+    {
+        for (int i=0; i < SR_LIVE_CACHE_SIZE; i++)
+            sr_live_cache[i].gen = 0;
+        sr_live_gen = 1;
+    }
+}
 
-                    /* If instruction is a branch break the scan */
-                    if (M68K_IsBranch(insn_stream))
-                        break;
+static uint8_t SR_LiveIn(uint16_t *insn_stream, int depth);
 
-                    /* Get opcode */
-                    opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)insn_stream);
+/* Flags live after the instruction, i.e. at entry of all its possible successors */
+static uint8_t SR_LiveOut(uint16_t *insn_stream, uint16_t opcode, int depth)
+{
+    if (!M68K_IsBranch(insn_stream))
+        return SR_LiveIn(insn_stream + M68K_GetINSNLength(insn_stream), depth + 1);
 
-                    D(kprintf("[JIT]   %02d.1: opcode=%04x @ %08x ", scan_depth, opcode, insn_stream));
+    /* BRA/BSR, follow the branch */
+    if ((opcode & 0xfe00) == 0x6000)
+    {
+        int32_t branch_offset = (int8_t)(opcode & 0xff);
+
+        if ((opcode & 0xff) == 0) {
+            branch_offset = (int16_t)cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
+        } else if ((opcode & 0xff) == 0xff) {
+            uint16_t lo16, hi16;
+            hi16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
+            lo16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[2]);
+            branch_offset = lo16 | (hi16 << 16);
+        }
 
-                    uint32_t flags = SRCheck[opcode >> 12](opcode);
-                    tmp_sets = flags & 0x1f;
-                    tmp_needs = (flags >> 16) & 0x1f;
+        D(kprintf("[JIT]   %02d: PC-relative jump by %d bytes\n", depth, branch_offset));
 
-                    D(kprintf(" SRNeeds = %x, SRSets = %x\n", tmp_needs, tmp_sets));
+        return SR_LiveIn(insn_stream + 1 + (branch_offset >> 1), depth + 1);
+    }
+    /* JMP/JSR to absolute address, follow the branch */
+    else if ((opcode & 0xffbe) == 0x4eb8)
+    {
+        uint16_t *target;
+
+        if (opcode & 1) {
+            uint16_t lo16, hi16;
+            hi16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
+            lo16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[2]);
+            target = (uint16_t*)(uintptr_t)(lo16 | (hi16 << 16));
+        } else {
+            target = (uint16_t*)(uintptr_t)((uint32_t)cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]));
+        }
 
-                    /* If instruction *needs* one of flags from current opcode, break the check and return mask */
-                    if (mask1 & tmp_needs) {
-                        needed1 |= (mask1 & tmp_needs);
-                    }
+        D(kprintf("[JIT]   %02d: Absolute jump to %08x\n", depth, target));
 
-                    /* Clear flags which this instruction sets */
-                    mask1 = mask1 & ~tmp_sets;
+        return SR_LiveIn(target, depth + 1);
+    }
+    /* Bcc, flags live on any of the two paths */
+    else if ((opcode & 0xf000) == 0x6000)
+    {
+        int32_t branch_offset = (int8_t)(opcode & 0xff);
+        uint16_t *insn_stream_2 = insn_stream + 1;
+
+        if ((opcode & 0xff) == 0) {
+            branch_offset = (int16_t)cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
+            insn_stream_2++;
+        } else if ((opcode & 0xff) == 0xff) {
+            uint16_t lo16, hi16;
+            hi16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
+            lo16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[2]);
+            branch_offset = lo16 | (hi16 << 16);
+            insn_stream_2+=2;
+        }
 
-                    if ((mask1 & tmp_needs) == mask1) {
-                        break;
-                    }
+        D(kprintf("[JIT]   %02d: Splitting into two paths %08x and %08x\n", depth, insn_stream + 1 + (branch_offset >> 1), insn_stream_2));
 
-                    /* Advance to subsequent instruction */
-                    insn_stream += M68K_GetINSNLength(insn_stream);
-                }
+        uint8_t live = SR_LiveIn(insn_stream + 1 + (branch_offset >> 1), depth + 1);
 
-                scan_depth = scan_depth_tmp;
+        if (live != SR_CCR)
+            live |= SR_LiveIn(insn_stream_2, depth + 1);
 
-                while(mask2 && scan_depth < max_scan_depth)
-                {
-                    scan_depth++;
+        return live;
+    }
 
-                    /* If instruction is a branch break the scan */
-                    if (M68K_IsBranch(insn_stream_2))
-                        break;
+    /* Any other change of flow, assume all flags are needed */
+    D(kprintf("[JIT]   %02d: check breaks on branch\n", depth));
 
-                    /* Get opcode */
-                    opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)insn_stream_2);
+    return SR_CCR;
+}
 
-                    D(kprintf("[JIT]   %02d.2: opcode=%04x @ %08x ", scan_depth, opcode, insn_stream_2));
+static uint8_t SR_LiveIn(uint16_t *insn_stream, int depth)
+{
+    uint32_t addr = (uint32_t)(uintptr_t)insn_stream;
+    struct SRLiveEntry *e = &sr_live_cache[(addr >> 1) & (SR_LIVE_CACHE_SIZE - 1)];
+    int cached = 0;
 
-                    uint32_t flags = SRCheck[opcode >> 12](opcode);
-                    tmp_sets = flags & 0x1f;
-                    tmp_needs = (flags >> 16) & 0x1f;
+    if (depth > sr_max_depth || !M68K_InCodeWindow(insn_stream))
+        return SR_CCR;
 
-                    D(kprintf(" SRNeeds = %x, SRSets = %x\n", tmp_needs, tmp_sets));
+    if (e->gen == sr_live_gen && e->addr == addr)
+    {
+        /* Loop back to an instruction which is still being analyzed, assume all flags needed */
+        if (e->live & SR_LIVE_PENDING)
+            return SR_CCR;
 
-                    /* If instruction *needs* one of flags from current opcode, break the check and return mask */
-                    if (mask2 & tmp_needs) {
-                        needed2 |= (mask2 & tmp_needs);
-                    }
+        return e->live;
+    }
 
-                    /* Clear flags which this instruction sets */
-                    mask2 = mask2 & ~tmp_sets;
+    /* Slot of an instruction under analysis cannot be taken, it breaks the loop detection */
+    if (e->gen != sr_live_gen || !(e->live & SR_LIVE_PENDING))
+    {
+        e->addr = addr;
+        e->gen = sr_live_gen;
+        e->live = SR_LIVE_PENDING;
+        cached = 1;
+    }
 
-                    if ((mask2 & tmp_needs) == mask2) {
-                        break;
-                    }
+    uint16_t opcode = cache_read_16(ICACHE, addr);
+    uint32_t flags = SRCheck[opcode >> 12](opcode);
+    uint8_t sets = flags & SR_CCR;
+    uint8_t live = (flags >> 16) & SR_CCR;
 
-                    /* Advance to subsequent instruction */
-                    insn_stream_2 += M68K_GetINSNLength(insn_stream_2);
-                }
+    D(kprintf("[JIT]   %02d: opcode=%04x @ %08x SRNeeds = %x, SRSets = %x\n", depth, opcode, insn_stream, live, sets));
 
-                D(kprintf("[JIT]   joining masks %x and %x to %x\n", mask1 | needed1, mask2 | needed2, mask1 | needed1 | mask2 | needed2));
+    /* Flags which are needed or set by the instruction do not depend on the successors */
+    if ((live | sets) != SR_CCR)
+        live |= SR_LiveOut(insn_stream, opcode, depth) & ~sets;
 
-                return mask1 | needed1 | mask2 | needed2;
-            }
-            else 
-            {
-                D(kprintf("[JIT]   %02d: check breaks on branch\n", scan_depth));
-                break;
-            }
-        }
-        else          
-        {
-            /* Advance to subsequent instruction */
-            insn_stream += M68K_GetINSNLength(insn_stream);
-        }
-        
-        /* Get opcode */
-        opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)insn_stream);
-        D(kprintf("[JIT]   %02d: opcode=%04x @ %08x ", scan_depth, opcode, insn_stream));
+    if (cached)
+        e->live = live;
 
-        uint32_t flags = SRCheck[opcode >> 12](opcode);
-        tmp_sets = flags & 0x1f;
-        tmp_needs = (flags >> 16) & 0x1f;
+    return live;
+}
 
-        D(kprintf(" SRNeeds = %x, SRSets = %x\n", tmp_needs, tmp_sets));
+/* Get the mask of status flags changed by the instruction specified by the opcode */
+uint8_t M68K_GetSRMask(uint16_t *insn_stream)
+{
+    uint16_t opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)insn_stream);
+    uint8_t mask = SRCheck[opcode >> 12](opcode) & SR_CCR;
 
-        /* If instruction *needs* one of flags from current opcode, break the check and return mask */
-        if (mask & tmp_needs) {
-            needed |= (mask & tmp_needs);
-        }
+    sr_max_depth = (__m68k_state->JIT_CONTROL2 >> JC2B_CCR_SCAN_DEPTH) & JC2_CCR_SCAN_MASK;
 
-        /* Clear flags which this instruction sets */
-        mask = mask & ~tmp_sets;
+    D(kprintf("[JIT] GetSRMask, opcode %04x @ %08x, SRSets = %x\n", opcode, insn_stream, mask));
 
-        if ((mask & tmp_needs) == mask) {
-            break;
-        }
-    }
+    if (mask != 0 && sr_max_depth != 0)
+        mask &= SR_LiveOut(insn_stream, opcode, 0);
 
-    D(kprintf("[JIT] GetSRMask returns %x\n", mask | needed));
+    D(kprintf("[JIT] GetSRMask returns %x\n", mask));
 
-    return mask | needed;
+    return mask;
 }
@@ -0,0 +1,279 @@
+/*
+    Copyright © 2019 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include "config.h"
+#include "support.h"
+#include "M68k.h"
+#include "EmuFeatures.h"
+#include "devicetree.h"
+#include "lists.h"
+#include "md5.h"
+#include "version.h"
+
+/*
+    Translation snapshot. Units translated from read-only ROM ranges can be stored in a blob and put
+    back into the JIT cache on the next boot, so that Kickstart does not need to be translated again.
+    The blob is valid only for the same ROM, the same build of Emu68 with the same CPU features and
+    boot arguments, and the same JIT settings. All of that is verified before any unit is loaded.
+
+    Layout of the blob is a header followed by unit records. Every record is followed by ARM code of
+    the unit with all direct links reverted.
+*/
+
+#define SNAPSHOT_VERSION    2
+
+struct SnapshotHeader {
+    uint32_t    sh_Magic;
+    uint32_t    sh_Version;
+    uint32_t    sh_Size;            /* Size of the blob including header */
+    uint32_t    sh_CRC;             /* CRC32 of everything following the header */
+    uint32_t    sh_BuildID;         /* CRC32 of Emu68 version, features and boot arguments */
+    uint32_t    sh_Anchor;          /* Address of a kernel function, catches differently linked builds */
+    uint32_t    sh_ROMCRC;          /* CRC32 of 0xf80000-0xffffff */
+    uint32_t    sh_ExtCRC;          /* CRC32 of 0xe00000-0xe7ffff, zero if no unit covers this range */
+    uint32_t    sh_JITControl;
+    uint32_t    sh_JITControl2;
+    uint32_t    sh_UnitCount;
+};
+
+struct SnapshotUnit {
+    uint32_t    su_M68kAddress;
+    uint32_t    su_M68kLow;
+    uint32_t    su_M68kHigh;
+    uint32_t    su_CRC32;
+    uint32_t    su_M68kInsnCnt;
+    uint32_t    su_ARMInsnCnt;
+    uint16_t    su_PrologueSize;
+    uint16_t    su_EpilogueSize;
+    uint16_t    su_Conditionals;
+    uint16_t    su_Tier;
+    uint32_t    su_ExitCount;
+    uint32_t    su_ExitPC[EMU68_TRACE_EXITS];   /* Branches counted by EMIT_CountExit code of the unit */
+};
+
+extern struct M68KState *__m68k_state;
+extern struct List LRU;
+
+static uint32_t SnapshotBuildID()
+{
+    static const char build[] = VERSION_STRING GIT_SHA BUILD_VARIANT;
+    uint32_t id = CalcCRC32((void *)build, (void *)&build[sizeof(build) - 1]);
+    of_node_t *e = dt_find_node("/chosen");
+
+    id ^= CalcCRC32((void *)&Features, (void *)((uintptr_t)&Features + sizeof(Features)));
+
+    if (e)
+    {
+        of_property_t *p = dt_find_property(e, "bootargs");
+
+        if (p && p->op_length != 0)
+            id ^= CalcCRC32(p->op_value, (void *)((uintptr_t)p->op_value + p->op_length));
+    }
+
+    return id;
+}
+
+static inline int SnapshotInROM(uint32_t addr)
+{
+    return addr >= 0xf80000 && addr <= 0x1000000;
+}
+
+static inline int SnapshotInExtROM(uint32_t addr)
+{
+    return addr >= 0xe00000 && addr <= 0xe80000;
+}
+
+/* Units which can be stored: translated completely from ROM and not pending verification */
+static int SnapshotUnitValid(struct M68KTranslationUnit *unit)
+{
+    uint32_t low = (uint32_t)(uintptr_t)unit->mt_M68kLow;
+    uint32_t high = (uint32_t)(uintptr_t)unit->mt_M68kHigh;
+
+    if (unit->mt_Tier == 0 || ((uintptr_t)unit->mt_ARMEntryPoint >> 56) != 0xff)
+        return 0;
+
+    return (SnapshotInROM(low) && SnapshotInROM(high)) || (SnapshotInExtROM(low) && SnapshotInExtROM(high));
+}
+
+/*
+    Store the snapshot in the buffer. On input the first longword of the buffer holds its size. If
+    the buffer is zero or too small, nothing is stored. In any case the size of the blob (or zero on
+    failure) is available in JITSNAPSHOT register afterwards.
+*/
+void M68K_SnapshotSave(uint32_t buffer)
+{
+    struct M68KState *ctx = __m68k_state;
+    struct SnapshotHeader *h = (void *)(uintptr_t)buffer;
+    uint32_t capacity = h ? *(uint32_t *)h : 0;
+    uint32_t size = sizeof(struct SnapshotHeader);
+    uint32_t count = 0;
+    int ext = 0;
+    struct Node *n;
+
+    ForeachNode(&LRU, n)
+    {
+        struct M68KTranslationUnit *unit = (void *)((uintptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+
+        if (SnapshotUnitValid(unit))
+        {
+            size += sizeof(struct SnapshotUnit) + 4 * (unit->mt_ARMInsnCnt + 1);
+            ext |= SnapshotInExtROM((uint32_t)(uintptr_t)unit->mt_M68kLow);
+            count++;
+        }
+    }
+
+    ctx->JIT_SNAPSHOT_SIZE = size;
+
+    if (h == NULL)
+        return;
+
+    if (capacity < size || count == 0)
+    {
+        kprintf("[JIT] Snapshot of %d units needs %d bytes, buffer has %d\n", count, size, capacity);
+        ctx->JIT_SNAPSHOT_SIZE = 0;
+        return;
+    }
+
+    uint8_t *out = (uint8_t *)&h[1];
+
+    ForeachNode(&LRU, n)
+    {
+        struct M68KTranslationUnit *unit = (void *)((uintptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+        struct SnapshotUnit *su = (void *)out;
+        uint32_t *code = (uint32_t *)&su[1];
+        struct Node *l;
+
+        if (!SnapshotUnitValid(unit))
+            continue;
+
+        su->su_M68kAddress = (uint32_t)(uintptr_t)unit->mt_M68kAddress;
+        su->su_M68kLow = (uint32_t)(uintptr_t)unit->mt_M68kLow;
+        su->su_M68kHigh = (uint32_t)(uintptr_t)unit->mt_M68kHigh;
+        su->su_CRC32 = unit->mt_CRC32;
+        su->su_M68kInsnCnt = unit->mt_M68kInsnCnt;
+        su->su_ARMInsnCnt = unit->mt_ARMInsnCnt;
+        su->su_PrologueSize = unit->mt_PrologueSize;
+        su->su_EpilogueSize = unit->mt_EpilogueSize;
+        su->su_Conditionals = unit->mt_Conditionals;
+        su->su_Tier = unit->mt_Tier;
+        su->su_ExitCount = unit->mt_ExitCount;
+        for (uint32_t i=0; i < EMU68_TRACE_EXITS; i++)
+            su->su_ExitPC[i] = i < unit->mt_ExitCount ? unit->mt_Exits[i].ep_M68kPC : 0;
+
+        memcpy(code, &unit->mt_ARMCode[0], 4 * (unit->mt_ARMInsnCnt + 1));
+
+        /* Direct links and inline caches point to units which will not exist after reboot */
+        ForeachNode(&unit->mt_ChainOut, l)
+        {
+            struct M68KChainLink *link = (void *)((uintptr_t)l - __builtin_offsetof(struct M68KChainLink, cl_OutNode));
+
+            code[link->cl_Slot - &unit->mt_ARMCode[0]] = link->cl_Insn;
+        }
+
+        out = (uint8_t *)&code[unit->mt_ARMInsnCnt + 1];
+    }
+
+    h->sh_Magic = M68K_SNAPSHOT_MAGIC;
+    h->sh_Version = SNAPSHOT_VERSION;
+    h->sh_Size = size;
+    h->sh_BuildID = SnapshotBuildID();
+    h->sh_Anchor = (uint32_t)(uintptr_t)M68K_GetTranslationUnit;
+    h->sh_ROMCRC = CalcCRC32((void *)0xf80000, (void *)0x1000000);
+    h->sh_ExtCRC = ext ? CalcCRC32((void *)0xe00000, (void *)0xe80000) : 0;
+    h->sh_JITControl = ctx->JIT_CONTROL;
+    h->sh_JITControl2 = ctx->JIT_CONTROL2;
+    h->sh_UnitCount = count;
+    h->sh_CRC = CalcCRC32(&h[1], (void *)((uintptr_t)h + size));
+
+    kprintf("[JIT] Snapshot of %d units (%d bytes) stored at %08x, ROM CRC32 %08x\n", count, size, buffer, h->sh_ROMCRC);
+}
+
+/*
+    Verify the blob and put all units from it into the JIT cache. Every unit is verified against
+    the checksum of its m68k code before it is added.
+*/
+void M68K_SnapshotLoad(void *blob, uint32_t size)
+{
+    struct M68KState *ctx = __m68k_state;
+    struct SnapshotHeader *h = blob;
+    uint8_t *in = (uint8_t *)&h[1];
+    uint32_t loaded = 0;
+
+    if (size < sizeof(struct SnapshotHeader) || h->sh_Magic != M68K_SNAPSHOT_MAGIC ||
+        h->sh_Version != SNAPSHOT_VERSION || h->sh_Size > size)
+    {
+        kprintf("[JIT] Snapshot at %p not recognized\n", blob);
+        return;
+    }
+
+    if (h->sh_CRC != CalcCRC32(&h[1], (void *)((uintptr_t)h + h->sh_Size)))
+    {
+        kprintf("[JIT] Snapshot is corrupted\n");
+        return;
+    }
+
+    if (h->sh_BuildID != SnapshotBuildID() || h->sh_Anchor != (uint32_t)(uintptr_t)M68K_GetTranslationUnit)
+    {
+        kprintf("[JIT] Snapshot was created by different build or configuration of Emu68\n");
+        return;
+    }
+
+    if (h->sh_JITControl != ctx->JIT_CONTROL || h->sh_JITControl2 != ctx->JIT_CONTROL2)
+    {
+        kprintf("[JIT] Snapshot was created with different JIT settings\n");
+        return;
+    }
+
+    if (h->sh_ROMCRC != CalcCRC32((void *)0xf80000, (void *)0x1000000) ||
+        (h->sh_ExtCRC != 0 && h->sh_ExtCRC != CalcCRC32((void *)0xe00000, (void *)0xe80000)))
+    {
+        kprintf("[JIT] Snapshot does not match the ROM\n");
+        return;
+    }
+
+    for (uint32_t i=0; i < h->sh_UnitCount; i++)
+    {
+        struct SnapshotUnit *su = (void *)in;
+        uint32_t *code = (uint32_t *)&su[1];
+        struct M68KTranslationUnit tmpl;
+
+        in = (uint8_t *)&code[su->su_ARMInsnCnt + 1];
+
+        if ((uintptr_t)in > (uintptr_t)h + h->sh_Size)
+            break;
+
+        tmpl.mt_M68kAddress = (uint16_t *)(uintptr_t)su->su_M68kAddress;
+        tmpl.mt_M68kLow = (uint16_t *)(uintptr_t)su->su_M68kLow;
+        tmpl.mt_M68kHigh = (uint16_t *)(uintptr_t)su->su_M68kHigh;
+        tmpl.mt_CRC32 = su->su_CRC32;
+        tmpl.mt_M68kInsnCnt = su->su_M68kInsnCnt;
+        tmpl.mt_ARMInsnCnt = su->su_ARMInsnCnt;
+        tmpl.mt_PrologueSize = su->su_PrologueSize;
+        tmpl.mt_EpilogueSize = su->su_EpilogueSize;
+        tmpl.mt_Conditionals = su->su_Conditionals;
+        tmpl.mt_Tier = su->su_Tier;
+        tmpl.mt_ExitCount = su->su_ExitCount;
+        for (uint32_t i=0; i < EMU68_TRACE_EXITS; i++)
+            tmpl.mt_Exits[i].ep_M68kPC = su->su_ExitPC[i];
+
+        if (tmpl.mt_ExitCount > EMU68_TRACE_EXITS)
+            continue;
+
+        if (CalcCRC32(tmpl.mt_M68kLow, tmpl.mt_M68kHigh) != tmpl.mt_CRC32)
+            continue;
+
+        if (M68K_LoadUnit(&tmpl, code) == NULL)
+            break;
+
+        loaded++;
+    }
+
+    kprintf("[JIT] Loaded %d of %d units from snapshot\n", loaded, h->sh_UnitCount);
+}
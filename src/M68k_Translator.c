@@ -19,6 +19,7 @@
 #include "DuffCopy.h"
 #include "disasm.h"
 #include "cache.h"
+#include "mmu.h"
 
 #if SET_FEATURES_AT_RUNTIME
 features_t Features;
@@ -43,13 +44,116 @@ static inline int globalDisasm() {
     return disasm;
 }
 
-struct List ICache[EMU68_HASHSIZE];
+struct M68KLookupEntry ICache[EMU68_LOOKUP_SIZE] __attribute__((aligned(64)));
+static uint32_t lookup_used;
 struct List LRU;
+#if EMU68_TIERED_JIT
+/* Unit which is being promoted at the moment. Cleared if the unit gets released during translation */
+static struct M68KTranslationUnit *promoted_unit;
+#endif
+/* Tier of the unit being translated and its counted conditional exits */
+static int translation_tier;
+static uint32_t exit_count;
+static struct M68KExitProfile exit_profile[EMU68_TRACE_EXITS];
+#if EMU68_JIT_WORKER
+/*
+    Background translation. The worker owns the translator while it holds jit_lock, the emulation
+    core takes the lock in every path which translates or releases units. Units made by the worker
+    are kept on jit_ready until the dispatcher misses and adopts them into lookup table, so that the
+    lookup table is modified by the emulation core only.
+*/
+static volatile uint8_t jit_lock;
+static int jit_worker_active;
+static struct List jit_ready;
+static uint32_t jit_requests[EMU68_JIT_WORKER_QUEUE];
+static volatile uint32_t jit_request_head;
+static volatile uint32_t jit_request_tail;
+static uint16_t *jit_successors[EMU68_JIT_WORKER_SUCC];
+static int jit_successor_count;
+#endif
+
+/* Region of the JIT cache. Units are allocated from it by bumping jr_Top */
+struct JITRegion {
+    uintptr_t   jr_Base;
+    uintptr_t   jr_Top;
+    uintptr_t   jr_End;
+    uint32_t    jr_Holes;       /* Bytes of released units which cannot be reused until eviction */
+    struct List jr_Units;       /* Units in order of their addresses */
+};
+
+/* Reverse map of m68k pages, bucket is given by lowest bits of the page number */
+static struct List page_map[EMU68_PAGEMAP_SIZE];
+static struct List page_wide;
+
+/*
+    State of m68k pages with write protection enabled. WP_PROTECTED marks pages mapped read-only by
+    the JIT, lower bits count how many times protection of the page was lost on a write
+*/
+#define WP_PROTECTED    0x80
+#define WP_FAULTS       0x7f
+static uint8_t *wp_pages;
+
+static struct JITRegion jit_region[EMU68_JIT_REGIONS];
+static int jit_region_count;
+static int jit_region_current;
+static uint32_t jit_cache_size;
+static uint32_t jit_cache_used;
+
 static uint32_t *temporary_arm_code;
+
+#if EMU68_FAULT_PATCH
+/*
+    Loads and stores which fault repeatedly are patched into a branch to an out of line stub calling
+    the bus helper. The stub checks the address first, accesses which do not go to the Amiga bus are
+    done by the original instruction. Faults are counted per ARM PC in a direct mapped table. Every patched site has a
+    chain link in mt_ChainOut of its unit (cl_InNode is kept on fault_links), so the original
+    instruction is put back whenever the unit is unlinked, moved or stored in a snapshot.
+*/
+#define FAULT_STUB_SIZE 64
+struct FaultSite {
+    uintptr_t   fs_PC;
+    uint32_t    fs_Count;
+};
+static struct FaultSite fault_sites[EMU68_FAULT_SITES];
+static struct List fault_links;
+static uint32_t *fault_stubs;
+static uint32_t fault_stub_next;
+#endif
 static struct M68KLocalState *local_state;
 
+/*
+    Offset of the m68k PC relative to REG_PC. REG_PC + _pc_rel is always the address of currently
+    translated instruction, which is known at translation time. Therefore straight-line code never
+    updates REG_PC, it is materialized only when an instruction needs it or when the code leaves
+    the unit (exit, branch, exception).
+*/
 int32_t _pc_rel = 0;
 
+/* Add offset to REG_PC, offsets beyond 12 bits are split into two instructions */
+static uint32_t *EMIT_AddPC(uint32_t *ptr, int32_t offset)
+{
+    uint32_t abs_offset = offset < 0 ? -offset : offset;
+
+    if (abs_offset >> 12)
+    {
+        if (offset > 0)
+            *ptr++ = add_immed_lsl12(REG_PC, REG_PC, abs_offset >> 12);
+        else
+            *ptr++ = sub_immed_lsl12(REG_PC, REG_PC, abs_offset >> 12);
+        abs_offset &= 0xfff;
+    }
+
+    if (abs_offset != 0)
+    {
+        if (offset > 0)
+            *ptr++ = add_immed(REG_PC, REG_PC, abs_offset);
+        else
+            *ptr++ = sub_immed(REG_PC, REG_PC, abs_offset);
+    }
+
+    return ptr;
+}
+
 uint32_t *EMIT_GetOffsetPC(uint32_t *ptr, int8_t *offset)
 {
     // Calculate new PC relative offset
@@ -58,10 +162,7 @@ uint32_t *EMIT_GetOffsetPC(uint32_t *ptr, int8_t *offset)
     // If overflow would occur then compute PC and get new offset
     if (new_offset > 127 || new_offset < -127)
     {
-        if (_pc_rel > 0)
-            *ptr++ = add_immed(REG_PC, REG_PC, _pc_rel);
-        else
-            *ptr++ = sub_immed(REG_PC, REG_PC, -_pc_rel);
+        ptr = EMIT_AddPC(ptr, _pc_rel);
 
         _pc_rel = 0;
         new_offset = *offset;
@@ -74,36 +175,30 @@ uint32_t *EMIT_GetOffsetPC(uint32_t *ptr, int8_t *offset)
 
 uint32_t *EMIT_AdvancePC(uint32_t *ptr, uint8_t offset)
 {
-//if (debug)    kprintf("Emit_AdvancePC(pc_rel=%d, off=%d)\n", _pc_rel, (int)offset);
-    // Calculate new PC relative offset
     _pc_rel += (int)offset;
 
-    // If overflow would occur then compute PC and get new offset
-    if (_pc_rel > 120 || _pc_rel < -120)
-    {
-        if (_pc_rel > 0)
-            *ptr++ = add_immed(REG_PC, REG_PC, _pc_rel);
-        else
-            *ptr++ = sub_immed(REG_PC, REG_PC, -_pc_rel);
-
-        _pc_rel = 0;
-    }
-
     return ptr;
 }
 
 uint32_t *EMIT_FlushPC(uint32_t *ptr)
 {
-    if (_pc_rel > 0)
-            *ptr++ = add_immed(REG_PC, REG_PC, _pc_rel);
-    else if (_pc_rel < 0)
-            *ptr++ = sub_immed(REG_PC, REG_PC, -_pc_rel);
+    ptr = EMIT_AddPC(ptr, _pc_rel);
 
     _pc_rel = 0;
 
     return ptr;
 }
 
+/*
+    Materialize PC of currently translated instruction plus given offset on a path which leaves the
+    unit (e.g. exception). The PC offset of the code continuing in the unit is not changed, so that
+    the fall-through path does not need to update REG_PC at all.
+*/
+uint32_t *EMIT_MaterializePC(uint32_t *ptr, int32_t offset)
+{
+    return EMIT_AddPC(ptr, _pc_rel + offset);
+}
+
 uint32_t *EMIT_ResetOffsetPC(uint32_t *ptr)
 {
     _pc_rel = 0;
@@ -234,6 +329,74 @@ void M68K_ResetReturnStack()
     ReturnStackDepth = 0;
 }
 
+static inline int M68K_InROM(uintptr_t addr)
+{
+    return (addr >= 0xf80000 && addr < 0x1000000) || (addr >= 0xe00000 && addr < 0xe80000);
+}
+
+/*
+    Range of m68k memory the translator may read code from. It spans the whole address space, except
+    for units made by the translation worker, which may read the pages verified before, only. Code
+    which would be read outside of the window ends the unit or is treated as unknown.
+*/
+static uint32_t code_window_low = 0;
+static uint32_t code_window_high = 0xffffffff;
+
+/* The instruction at ptr together with a few instructions following it must be within the window */
+#define CODE_WINDOW_MARGIN  128
+
+int M68K_InCodeWindow(uint16_t *ptr)
+{
+    uint64_t addr = (uintptr_t)ptr;
+
+    return addr >= code_window_low && addr + CODE_WINDOW_MARGIN <= (uint64_t)code_window_high;
+}
+
+/*
+    Check if subroutine called at given site can be inlined. The target has to be within inline range
+    and either both site and target are above 16MB, or both are in ROM. In addition the callee must be
+    a short leaf function which reaches its RTS within EMU68_INLINE_CALL_SIZE instructions, with no
+    other branches than Bcc on its way. The RTS of inlined code verifies the return address anyway.
+*/
+int M68K_CanInlineCall(uint16_t *site, uint16_t *target)
+{
+    int32_t range = (__m68k_state->JIT_CONTROL >> JCCB_INLINE_RANGE) & JCCB_INLINE_RANGE_MASK;
+    intptr_t distance = (intptr_t)target - (intptr_t)site;
+    uint16_t *p = target;
+
+    if (!EMU68_USE_RETURN_STACK || distance < -range || distance > range)
+        return 0;
+
+    if (!((uintptr_t)site >= 0x01000000 && (uintptr_t)target >= 0x01000000) &&
+        !(M68K_InROM((uintptr_t)site) && M68K_InROM((uintptr_t)target)))
+        return 0;
+
+    for (int i=0; i < EMU68_INLINE_CALL_SIZE; i++)
+    {
+        uint16_t opcode;
+        int length;
+
+        if (!M68K_InCodeWindow(p))
+            return 0;
+
+        opcode = cache_read_16(ICACHE, (uintptr_t)p);
+
+        if (opcode == 0x4e75)
+            return 1;
+
+        if (M68K_IsBranch(p) && !((opcode & 0xf000) == 0x6000 && (opcode & 0x0e00) != 0))
+            return 0;
+
+        length = M68K_GetINSNLength(p);
+        if (length <= 0)
+            return 0;
+
+        p += length;
+    }
+
+    return 0;
+}
+
 uint16_t *m68k_high;
 uint16_t *m68k_low;
 uint32_t insn_count;
@@ -253,7 +416,7 @@ uint8_t reg_Load96;
 uint8_t reg_Save96;
 uint32_t val_FPIAR;
 
-uint32_t * EMIT_LocalExit(uint32_t *ptr, uint32_t insn_fixup)
+static uint32_t * EMIT_ExitState(uint32_t *ptr, uint32_t insn_fixup)
 {
     RA_StoreDirtyFPURegs(&ptr);
     RA_StoreDirtyM68kRegs(&ptr);
@@ -284,18 +447,322 @@ uint32_t * EMIT_LocalExit(uint32_t *ptr, uint32_t insn_fixup)
     (void)insn_fixup;
 #endif
 
+    return ptr;
+}
+
+/*
+    Emit exit stub for the case where m68k PC of the successor is known at translation time. As
+    long as the exit is not linked, the stub stores address of its slot in the context and returns
+    to the dispatcher. Dispatcher replaces the slot with a direct branch to the successor unit.
+    Pending interrupts and disabled instruction cache always leave through the dispatcher.
+
+        ldr     wT, [ctx, #INT]
+        cbnz    wT, 1f
+        mov     wT, v31.s[0]
+        tbz     wT, #CACRB_IE, 1f
+    slot:
+        adr     xT, slot            <- replaced with "b successor"
+        str     xT, [ctx, #JIT_CHAIN_SLOT]
+    1:  ret
+        .word   m68k address of successor
+        .word   offset of the slot in the unit (in words)
+*/
+static uint32_t * EMIT_ChainStub(uint32_t *ptr, uint16_t *target)
+{
+#if EMU68_JIT_WORKER
+    /* Constant exit of the unit, candidate for background translation */
+    if (jit_successor_count < EMU68_JIT_WORKER_SUCC)
+        jit_successors[jit_successor_count++] = target;
+#endif
+#if EMU68_BLOCK_CHAINING
+    uint8_t ctx = RA_TryCTX(&ptr);
+    uint8_t tmp = RA_AllocARMRegister(&ptr);
+    uint8_t own_ctx = 0;
+    uint32_t *slot;
+
+    if (ctx == 0xff)
+    {
+        ctx = RA_AllocARMRegister(&ptr);
+        *ptr++ = mrs(ctx, 3, 3, 13, 0, 3);
+        own_ctx = 1;
+    }
+
+    *ptr++ = ldr_offset(ctx, tmp, __builtin_offsetof(struct M68KState, INT));
+    *ptr++ = cbnz(tmp, 5);
+    *ptr++ = mov_simd_to_reg(tmp, 31, TS_S, 0);
+    *ptr++ = tbz(tmp, CACRB_IE, 3);
+    slot = ptr;
+    *ptr++ = adr(tmp, 0);
+    *ptr++ = str64_offset(ctx, tmp, __builtin_offsetof(struct M68KState, JIT_CHAIN_SLOT));
+    *ptr++ = bx_lr();
+    *ptr++ = (uint32_t)(uintptr_t)target;
+    *ptr++ = (uint32_t)(slot - temporary_arm_code);
+
+    if (own_ctx)
+        RA_FreeARMRegister(&ptr, ctx);
+    RA_FreeARMRegister(&ptr, tmp);
+#else
+    (void)target;
+    *ptr++ = bx_lr();
+#endif
+
+    return ptr;
+}
+
+/*
+    Emit exit stub for computed jumps (RTS, JMP, JSR). The stub carries an inline cache of two last
+    m68k targets together with ARM entry points of their units. On a hit the code branches directly
+    to the target unit. On a miss the address of the cache is reported in JIT_CHAIN_SLOT with bit 0
+    set and the dispatcher puts the new target into the cache.
+
+        ldr     wT, [ctx, #INT]
+        cbnz    wT, 3f
+        mov     wT, v31.s[0]
+        tbz     wT, #CACRB_IE, 3f
+        ldr     wT, ic
+        cmp     wT, wPC
+        b.ne    1f
+        ldr     xT, ic+8
+        br      xT
+    1:  ldr     wT, ic+4
+        cmp     wT, wPC
+        b.ne    2f
+        ldr     xT, ic+16
+        br      xT
+    2:  adr     xT, ic+1
+        str     xT, [ctx, #JIT_CHAIN_SLOT]
+    3:  ret
+        .align  3
+    ic: .word   1, 1                m68k targets, odd value never matches
+        .dword  0, 0                ARM entry points
+        .word   offset of ic in the unit (in words), 0
+*/
+static uint32_t * EMIT_InlineCacheStub(uint32_t *ptr)
+{
+#if EMU68_BLOCK_CHAINING
+    uint8_t ctx = RA_TryCTX(&ptr);
+    uint8_t tmp = RA_AllocARMRegister(&ptr);
+    uint8_t own_ctx = 0;
+    uint32_t *start;
+    int ic;
+
+    if (ctx == 0xff)
+    {
+        ctx = RA_AllocARMRegister(&ptr);
+        *ptr++ = mrs(ctx, 3, 3, 13, 0, 3);
+        own_ctx = 1;
+    }
+
+    /* Cache has to be aligned to 8 bytes within the unit */
+    start = ptr;
+    ic = 17;
+    if ((start + ic - temporary_arm_code) & 1)
+        ic++;
+
+    *ptr++ = ldr_offset(ctx, tmp, __builtin_offsetof(struct M68KState, INT));
+    *ptr++ = cbnz(tmp, 15);
+    *ptr++ = mov_simd_to_reg(tmp, 31, TS_S, 0);
+    *ptr++ = tbz(tmp, CACRB_IE, 13);
+    *ptr++ = ldr_pcrel(tmp, ic - 4);
+    *ptr++ = cmp_reg(tmp, REG_PC, LSL, 0);
+    *ptr++ = b_cc(A64_CC_NE, 3);
+    *ptr++ = ldr64_pcrel(tmp, ic + 2 - 7);
+    *ptr++ = br(tmp);
+    *ptr++ = ldr_pcrel(tmp, ic + 1 - 9);
+    *ptr++ = cmp_reg(tmp, REG_PC, LSL, 0);
+    *ptr++ = b_cc(A64_CC_NE, 3);
+    *ptr++ = ldr64_pcrel(tmp, ic + 4 - 12);
+    *ptr++ = br(tmp);
+    *ptr++ = adr(tmp, 4 * (ic - 14) + 1);
+    *ptr++ = str64_offset(ctx, tmp, __builtin_offsetof(struct M68KState, JIT_CHAIN_SLOT));
+    *ptr++ = bx_lr();
+    if (ic == 18)
+        *ptr++ = nop();
+
+    *ptr++ = 1;
+    *ptr++ = 1;
+    *ptr++ = 0;
+    *ptr++ = 0;
+    *ptr++ = 0;
+    *ptr++ = 0;
+    *ptr++ = (uint32_t)(start + ic - temporary_arm_code);
+    *ptr++ = 0;
+
+    if (own_ctx)
+        RA_FreeARMRegister(&ptr, ctx);
+    RA_FreeARMRegister(&ptr, tmp);
+#else
+    *ptr++ = bx_lr();
+#endif
+
+    return ptr;
+}
+
+uint32_t * EMIT_LocalExit(uint32_t *ptr, uint32_t insn_fixup)
+{
+    ptr = EMIT_ExitState(ptr, insn_fixup);
     *ptr++ = bx_lr();
 
     return ptr;
 }
 
+uint32_t * EMIT_ChainedLocalExit(uint32_t *ptr, uint32_t insn_fixup, uint16_t *target)
+{
+    ptr = EMIT_ExitState(ptr, insn_fixup);
+
+    if ((uintptr_t)target == M68K_EXIT_COMPUTED)
+        ptr = EMIT_InlineCacheStub(ptr);
+    else
+        ptr = EMIT_ChainStub(ptr, target);
+
+    return ptr;
+}
+
 uint16_t * m68k_entry_point;
+uint16_t * m68k_exit_target;
+
+#if EMU68_TIERED_JIT
+void trampoline_promote_unit();
+
+/*
+    Hot counter of the unit. Decrements mt_HotCount on every entry of the unit (including jumps back
+    from the inner loop). Once the counter of a first tier unit reaches zero, the unit is passed to
+    trampoline_promote_unit which translates it again and continues at new entry point. Second tier
+    units start with a counter which practically never expires, it is used by eviction of the JIT
+    cache regions only.
+*/
+_Static_assert(__builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode) -
+               __builtin_offsetof(struct M68KTranslationUnit, mt_HotCount) <= 256,
+               "mt_HotCount out of reach of ldur/stur from mt_ARMCode");
+
+static uint32_t *EMIT_HotCounter(uint32_t *ptr, uint32_t *arm_code)
+{
+    union {
+        uint64_t u64;
+        uint16_t u16[4];
+    } u;
+    uint8_t base = RA_AllocARMRegister(&ptr);
+    uint8_t cnt = RA_AllocARMRegister(&ptr);
+    int16_t off = (int16_t)__builtin_offsetof(struct M68KTranslationUnit, mt_HotCount) -
+                  (int16_t)__builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode);
+    int32_t dist = 4 * (arm_code - ptr);
+    uint32_t *tmp;
+
+    u.u64 = (uintptr_t)trampoline_promote_unit;
+
+    /* Get address of the code in RW mapping of JIT cache */
+    *ptr++ = adr(base, dist);
+    *ptr++ = bic64_immed(base, base, 1, 28, 1);
+    *ptr++ = ldur_offset(base, cnt, off);
+    *ptr++ = subs_immed(cnt, cnt, 1);
+    *ptr++ = stur_offset(base, cnt, off);
+    tmp = ptr++;
+    *ptr++ = sub64_immed(0, base, __builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode));
+    *ptr++ = mov64_immed_u16(1, u.u16[3], 0);
+    *ptr++ = movk64_immed_u16(1, u.u16[2], 1);
+    *ptr++ = movk64_immed_u16(1, u.u16[1], 2);
+    *ptr++ = movk64_immed_u16(1, u.u16[0], 3);
+    *ptr++ = br(1);
+    *tmp = b_cc(A64_CC_NE, ptr - tmp);
+
+    RA_FreeARMRegister(&ptr, cnt);
+    RA_FreeARMRegister(&ptr, base);
+
+    return ptr;
+}
+
+/* Increment the counter at given offset of the unit being translated, through RW mapping of JIT cache */
+static uint32_t *EMIT_UnitCounter(uint32_t *ptr, uint8_t base, uint8_t cnt, uint16_t off)
+{
+    int32_t dist = 4 * (temporary_arm_code - ptr);
+
+    *ptr++ = adr(base, dist);
+    *ptr++ = bic64_immed(base, base, 1, 28, 1);
+    *ptr++ = sub64_immed(base, base, __builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode));
+    *ptr++ = ldr_offset(base, cnt, off);
+    *ptr++ = add_immed(cnt, cnt, 1);
+    *ptr++ = str_offset(base, cnt, off);
+
+    return ptr;
+}
+
+/*
+    Count the conditional exit of first tier unit, the counter is kept in the unit itself. The code
+    is emitted on the exit path only, where x0 and x1 are free to use. Second tier units count
+    nothing.
+*/
+uint32_t *EMIT_CountExit(uint32_t *ptr, uint16_t *branch)
+{
+    uint32_t pc = (uint32_t)(uintptr_t)branch;
+    uint32_t i;
+
+    if (translation_tier != 1)
+        return ptr;
+
+    for (i=0; i < exit_count; i++)
+    {
+        if (exit_profile[i].ep_M68kPC == pc)
+            break;
+    }
+
+    if (i == EMU68_TRACE_EXITS)
+        return ptr;
+
+    if (i == exit_count)
+        exit_profile[exit_count++].ep_M68kPC = pc;
+
+    uint16_t off = __builtin_offsetof(struct M68KTranslationUnit, mt_Exits) + i * sizeof(struct M68KExitProfile) +
+                   __builtin_offsetof(struct M68KExitProfile, ep_Taken);
+
+    return EMIT_UnitCounter(ptr, 0, 1, off);
+}
+
+/*
+    Used by second tier translation. Returns non-zero if the first tier unit which is being promoted
+    left through the exit at given branch on large part of its entries. The hot counter of first tier
+    unit starts at EMU68_TIER2_THRESHOLD and is decremented on entries and jumps back of the inner
+    loop alike, the jumps back are counted separately and do not count as entries.
+*/
+int M68K_IsHotExit(uint16_t *branch)
+{
+    uint32_t pc = (uint32_t)(uintptr_t)branch;
+    int64_t entries;
+
+    if (translation_tier != 2 || promoted_unit == NULL)
+        return 0;
+
+    entries = (int64_t)EMU68_TIER2_THRESHOLD - promoted_unit->mt_HotCount - promoted_unit->mt_LoopCount;
+
+    if (entries <= 0)
+        return 0;
+
+    for (uint32_t i=0; i < promoted_unit->mt_ExitCount; i++)
+    {
+        if (promoted_unit->mt_Exits[i].ep_M68kPC == pc)
+            return (uint64_t)promoted_unit->mt_Exits[i].ep_Taken * 100 >= (uint64_t)entries * EMU68_TRACE_HOT_PERCENT;
+    }
+
+    return 0;
+}
+#else
+uint32_t *EMIT_CountExit(uint32_t *ptr, uint16_t *branch)
+{
+    (void)branch;
+    return ptr;
+}
+
+int M68K_IsHotExit(uint16_t *branch)
+{
+    (void)branch;
+    return 0;
+}
+#endif
 
-static inline uintptr_t M68K_Translate(uint16_t *m68kcodeptr)
+static inline uintptr_t M68K_Translate(uint16_t *m68kcodeptr, int tier)
 {
     m68k_entry_point = m68kcodeptr;
     uint16_t *orig_m68kcodeptr = m68kcodeptr;
-    uintptr_t hash = (uintptr_t)m68kcodeptr;
+    uint32_t hash = M68K_LookupHash((uint32_t)(uintptr_t)m68kcodeptr);
     int var_EMU68_MAX_LOOP_COUNT = (__m68k_state->JIT_CONTROL >> JCCB_LOOP_COUNT) & JCCB_LOOP_COUNT_MASK;
     if (var_EMU68_MAX_LOOP_COUNT == 0)
         var_EMU68_MAX_LOOP_COUNT = JCCB_LOOP_COUNT_MASK + 1;
@@ -328,10 +795,20 @@ static inline uintptr_t M68K_Translate(uint16_t *m68kcodeptr)
     }
 
     M68K_ResetReturnStack();
+    M68K_ResetSRLiveness();
+    M68K_ResetConstants();
+    EMIT_ResetHostFlags();
+    M68K_IRReset();
+
+    translation_tier = tier;
+    exit_count = 0;
+
+#if EMU68_JIT_WORKER
+    jit_successor_count = 0;
+#endif
 
     if (debug) {
-        uint32_t hash_calc = (hash >> EMU68_HASHSHIFT) & EMU68_HASHMASK;
-        kprintf("[ICache] Creating new translation unit with hash %04x (m68k code @ %p)\n", hash_calc, (void*)m68kcodeptr);
+        kprintf("[ICache] Creating new translation unit with hash %05x (m68k code @ %p)\n", hash, (void*)m68kcodeptr);
         if (debug > 1)
             M68K_PrintContext(__m68k_state);
     }
@@ -361,12 +838,20 @@ static inline uintptr_t M68K_Translate(uint16_t *m68kcodeptr)
         RA_FreeARMRegister(&end, reg);
     }
 
+#if EMU68_TIERED_JIT
+    if (tier != 0)
+        end = EMIT_HotCounter(end, arm_code);
+#else
+    (void)tier;
+#endif
+
     prologue_size = end - tmpptr;
 
     int break_loop = FALSE;
     int inner_loop = FALSE;
     int soft_break = FALSE;
     int max_rev_jumps = 0;
+    uint32_t loop_body = 0;
 
     m68k_low = m68kcodeptr;
     m68k_high = m68kcodeptr + 16;
@@ -377,6 +862,10 @@ static inline uintptr_t M68K_Translate(uint16_t *m68kcodeptr)
         uint16_t *in_code = m68kcodeptr;
         uint32_t *out_code = end;
 
+        /* Inlined branch or fall through left the code which may be read, end the unit here */
+        if (insn_count && !M68K_InCodeWindow(m68kcodeptr))
+            break;
+
         if (insn_count && ((uintptr_t)m68kcodeptr < (uintptr_t)local_state[insn_count-1].mls_M68kPtr))
         {
             int found = -1;
@@ -405,6 +894,9 @@ static inline uintptr_t M68K_Translate(uint16_t *m68kcodeptr)
         local_state[insn_count].mls_M68kPtr = m68kcodeptr;
         local_state[insn_count].mls_PCRel = _pc_rel;
 
+        m68k_exit_target = NULL;
+        M68K_IRSelect(m68kcodeptr);
+        RA_BeginInstruction();
         end = EmitINSN(end, &m68kcodeptr, &insn_consumed);
 
         if (m68kcodeptr < m68k_low)
@@ -433,9 +925,10 @@ static inline uintptr_t M68K_Translate(uint16_t *m68kcodeptr)
             uint32_t *tmpptr;
             uint32_t *branch_mod[10];
             uint32_t branch_cnt;
+            uint32_t exit_target;
             int local_branch_done = 0;
             end--;
-            end--;  /* Remove branch target (unused!) */
+            exit_target = *--end;   /* Branch target, if non-zero the exit can be chained or cached */
             branch_cnt = *--end;
 
             for (unsigned i=0; i < branch_cnt; i++)
@@ -451,7 +944,10 @@ static inline uintptr_t M68K_Translate(uint16_t *m68kcodeptr)
 
             if (!local_branch_done)
             {
-                end = EMIT_LocalExit(end, 0);
+                if (exit_target)
+                    end = EMIT_ChainedLocalExit(end, 0, (uint16_t *)(uintptr_t)exit_target);
+                else
+                    end = EMIT_LocalExit(end, 0);
             }
             int distance = end - tmpptr;
 
@@ -462,6 +958,8 @@ static inline uintptr_t M68K_Translate(uint16_t *m68kcodeptr)
             epilogue_size += distance;
         }
 
+        M68K_UpdateConstants(out_code, end);
+
         if (disasm)
             disasm_print(in_code, insn_consumed, out_code, 4*(end - out_code), temporary_arm_code);
 
@@ -484,6 +982,24 @@ static inline uintptr_t M68K_Translate(uint16_t *m68kcodeptr)
 
         if (!break_loop && (orig_m68kcodeptr == m68kcodeptr))
         {
+            if (loop_body == 0)
+                loop_body = insn_count;
+
+            /*
+                Small loop body is unrolled as long as the loop count allows. Every copy keeps its own
+                exit, but registers and CC stay live between copies and interrupts are checked only
+                once per all of them
+            */
+            if (loop_body <= EMU68_LOOP_UNROLL_BODY && max_rev_jumps > 1 &&
+                insn_count + loop_body <= var_EMU68_M68K_INSN_DEPTH)
+            {
+                if (debug)
+                    kprintf("[ICache]   Unrolling loop of %d instructions\n", loop_body);
+
+                soft_break = FALSE;
+                continue;
+            }
+
             if (debug)
                 kprintf("[ICache]   Creating loop within translation unit\n");
             
@@ -533,14 +1049,47 @@ static inline uintptr_t M68K_Translate(uint16_t *m68kcodeptr)
     if (inner_loop)
     {
         uint32_t *tmpptr = end;
+#if EMU68_TIERED_JIT
+        /* First tier counts jumps back, they pass the hot counter but are no entries of the unit */
+        if (tier == 1)
+        {
+            *end++ = cbnz(tmp2, 0);
+            end = EMIT_UnitCounter(end, tmp, tmp2, __builtin_offsetof(struct M68KTranslationUnit, mt_LoopCount));
+            *end = b(arm_code - end);
+            end++;
+            *tmpptr = cbnz(tmp2, end - tmpptr);
+        }
+        else
+#endif
+        {
 #ifdef PISTORM
-        *end++ = cbz(tmp2, arm_code - tmpptr);
-        //*end++ = tbnz(tmp2, 25, arm_code - tmpptr);
+            *end++ = cbz(tmp2, arm_code - tmpptr);
+            //*end++ = tbnz(tmp2, 25, arm_code - tmpptr);
 #else
-        *end++ = cbz(tmp2, arm_code - tmpptr);
+            *end++ = cbz(tmp2, arm_code - tmpptr);
 #endif
+        }
+        *end++ = bx_lr();
+    }
+    else if (!break_loop)
+    {
+        /* Translation stopped in the middle of code, next PC is known. Chain the exit */
+        end = EMIT_ChainStub(end, m68kcodeptr);
+    }
+    else if ((uintptr_t)m68k_exit_target == M68K_EXIT_COMPUTED)
+    {
+        /* Last instruction was a computed jump. Use inline cache for the exit */
+        end = EMIT_InlineCacheStub(end);
+    }
+    else if (m68k_exit_target != NULL)
+    {
+        /* Last instruction has left the unit with a constant PC. Chain the exit */
+        end = EMIT_ChainStub(end, m68k_exit_target);
+    }
+    else
+    {
+        *end++ = bx_lr();
     }
-    *end++ = bx_lr();
     
     uint32_t *_tmpptr = end;
     RA_FreeARMRegister(&end, tmp2);
@@ -575,6 +1124,8 @@ static inline uintptr_t M68K_Translate(uint16_t *m68kcodeptr)
         uint32_t mean_n = mean / 100;
         uint32_t mean_f = mean % 100;
         kprintf("[ICache]   Mean ARM instructions per m68k instruction: %d.%02d\n", mean_n, mean_f);
+        kprintf("[ICache]   Compares fused with Bcc by IR optimizer: %d\n", ir_fused_pairs);
+        kprintf("[ICache]   Conditional branches on host flags: %d\n", host_flags_branches);
     }
 
     return (uintptr_t)end - (uintptr_t)arm_code;
@@ -587,7 +1138,7 @@ static inline uintptr_t M68K_Translate(uint16_t *m68kcodeptr)
 */
 void *M68K_TranslateNoCache(uint16_t *m68kcodeptr)
 {
-    uintptr_t line_length = M68K_Translate(m68kcodeptr);
+    uintptr_t line_length = M68K_Translate(m68kcodeptr, 0);
     void *entry_point = (void*)temporary_arm_code;
 
     entry_point = (void *)((uintptr_t)entry_point | 0x0000001000000000ULL);
@@ -599,116 +1150,1257 @@ void *M68K_TranslateNoCache(uint16_t *m68kcodeptr)
 } 
 
 /*
-    Verify if the translated code has changed since the unit was created. In order
-    to do this MD5 sum of the block is compared with the previousy calculated one.
-
-    If th sums are not same, the block is removed form LRU cache and hashtable and memory
-    is released.
-
-    The function returns poitner to verified unit or NULL if the unit changed
+    Insert the unit into the lookup table. Table uses linear probing, the number of used entries
+    is kept below EMU68_LOOKUP_LIMIT by the caller so that there is always a free entry which
+    terminates the search.
 */
-struct M68KTranslationUnit *M68K_VerifyUnit(struct M68KTranslationUnit *unit)
+static void M68K_LookupInsert(uint32_t pc, void *entry)
 {
-    if (unit)
-    {
-        uint32_t crc = CalcCRC32(unit->mt_M68kLow, unit->mt_M68kHigh);
+    uint32_t idx = M68K_LookupHash(pc);
 
-        if (crc != unit->mt_CRC32)
-        {
-            REMOVE(&unit->mt_LRUNode);
-            REMOVE(&unit->mt_HashNode);
-            tlsf_free(jit_tlsf, unit);
+    while(ICache[idx].le_M68kAddress != M68K_LOOKUP_FREE && ICache[idx].le_M68kAddress != pc)
+        idx = (idx + 1) & EMU68_LOOKUP_MASK;
 
-            __m68k_state->JIT_UNIT_COUNT--;
-            __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+    if (ICache[idx].le_M68kAddress == M68K_LOOKUP_FREE)
+        lookup_used++;
 
-            unit = NULL;
+    ICache[idx].le_ARMEntryPoint = entry;
+    ICache[idx].le_M68kAddress = pc;
+}
+
+static struct M68KLookupEntry *M68K_LookupFind(struct M68KTranslationUnit *unit)
+{
+    uint32_t pc = (uint32_t)(uintptr_t)unit->mt_M68kAddress;
+    uint32_t idx = M68K_LookupHash(pc);
+
+    while(ICache[idx].le_M68kAddress != M68K_LOOKUP_FREE)
+    {
+        if (ICache[idx].le_M68kAddress == pc)
+        {
+            /* The entry may belong to a newer unit for the same address */
+            if (M68K_UnitFromEntry(ICache[idx].le_ARMEntryPoint) == unit)
+                return &ICache[idx];
+            break;
         }
+        idx = (idx + 1) & EMU68_LOOKUP_MASK;
     }
 
-    return unit;
+    return NULL;
 }
 
 /*
-    Get M68K code unit from the instruction cache. Return NULL if code was not found and needs to be
-    translated first.
-
-    If the code was found, update its position in the LRU cache.
+    Remove the unit from lookup table. Instead of leaving a tombstone, all following entries of the
+    probe sequence which would not be reachable anymore are shifted back into the free slot.
 */
-struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
+static void M68K_LookupRemove(struct M68KTranslationUnit *unit)
 {
-    struct M68KTranslationUnit *unit = NULL; //, *n;
-    uintptr_t hash = (uintptr_t)m68kcodeptr;
-    uint16_t *orig_m68kcodeptr = m68kcodeptr;
-    
-    int debug = 0;
-
-    if ((uint32_t)(uintptr_t)m68kcodeptr >= debug_range_min && (uint32_t)(uintptr_t)m68kcodeptr <= debug_range_max) {
-        debug = globalDebug();
-    }
+    struct M68KLookupEntry *e = M68K_LookupFind(unit);
+    uint32_t hole, idx;
 
-    /* Get 16-bit has from the pointer to m68k code */
-    hash = (hash >> EMU68_HASHSHIFT) & EMU68_HASHMASK;
+    if (e == NULL)
+        return;
 
-    if (debug > 2)
-        kprintf("[ICache] GetTranslationUnit(%08x)\n[ICache] Hash: 0x%04x\n", (void*)m68kcodeptr, (int)hash);
+    hole = e - ICache;
+    idx = hole;
 
-    if (unit == NULL)
+    while(1)
     {
-        uintptr_t line_length = M68K_Translate(m68kcodeptr);
-        uintptr_t arm_insn_count = line_length/4 - 1;
-
-        uintptr_t unit_length = (line_length + 63 + sizeof(struct M68KTranslationUnit)) & ~63;
-
-        do {
-            unit = tlsf_malloc_aligned(jit_tlsf, unit_length, 64);
+        idx = (idx + 1) & EMU68_LOOKUP_MASK;
 
-            __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+        if (ICache[idx].le_M68kAddress == M68K_LOOKUP_FREE)
+            break;
 
-            if (unit == NULL)
-            {
-                if (debug > 0) {
-                    kprintf("[ICache] Requested block was %d bytes long\n", unit_length);
-                }
+        uint32_t home = M68K_LookupHash(ICache[idx].le_M68kAddress);
 
-                for (int i=0; i < 8; i++) {
-                    struct Node *n = REMTAIL(&LRU);
+        /* Entry can be moved only if its home slot is not within (hole, idx] */
+        if (((idx - home) & EMU68_LOOKUP_MASK) >= ((idx - hole) & EMU68_LOOKUP_MASK))
+        {
+            ICache[hole] = ICache[idx];
+            hole = idx;
+        }
+    }
 
-                    if (n == NULL)
-                        break;
+    ICache[hole].le_M68kAddress = M68K_LOOKUP_FREE;
+    ICache[hole].le_ARMEntryPoint = NULL;
+    lookup_used--;
+}
 
-                    void *ptr = (char *)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode);
-                    REMOVE((struct Node *)ptr);
-                    if (debug > 0)
-                    {    
-                        kprintf("[ICache] Run out of cache. Removing least recently used cache line node @ %p\n", ptr);
-                    }
-                    tlsf_free(jit_tlsf, ptr);
-                    __m68k_state->JIT_UNIT_COUNT--;
-                }
-                __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
-                
-                asm volatile("msr tpidr_el1, %0"::"r"(0xffffffff));
+/*
+    Change entry point of the unit, e.g. when it is soft flushed or validated again. The copy of
+    entry point in the lookup table is updated too.
+*/
+void M68K_SetEntryPoint(struct M68KTranslationUnit *unit, void *entry)
+{
+    struct M68KLookupEntry *e = M68K_LookupFind(unit);
+
+    unit->mt_ARMEntryPoint = entry;
+
+    if (e != NULL)
+        e->le_ARMEntryPoint = entry;
+}
+
+/*
+    Revert all direct branches leading into the unit. From now on all exits which were linked to
+    the unit return to the dispatcher again. Has to be called whenever the unit is about to be
+    discarded or its entry point is invalidated (soft flush).
+*/
+void M68K_UnlinkUnit(struct M68KTranslationUnit *unit)
+{
+    struct Node *n, *next;
+
+    ForeachNodeSafe(&unit->mt_ChainIn, n, next)
+    {
+        struct M68KChainLink *link = (void *)((uintptr_t)n - __builtin_offsetof(struct M68KChainLink, cl_InNode));
+        uintptr_t slot = (uintptr_t)link->cl_Slot;
+
+        *link->cl_Slot = link->cl_Insn;
+        arm_flush_cache(slot, 4);
+        arm_icache_invalidate(slot | 0x0000001000000000ULL, 4);
+
+        REMOVE(&link->cl_InNode);
+        REMOVE(&link->cl_OutNode);
+        tlsf_free(tlsf, link);
+    }
+}
+
+/*
+    Write protection of translated code. Pages holding m68k code are mapped read-only, the first
+    write to such page invalidates only the units on that page and gives write access back. Pages
+    which were written too often, or cannot be protected at all, are left alone from then on.
+*/
+void M68K_EnableWriteProtect()
+{
+    wp_pages = tlsf_malloc(tlsf, 1 << 20);
+
+    if (wp_pages != NULL)
+    {
+        memset(wp_pages, 0, 1 << 20);
+        kprintf("[ICache] Write protection of translated code enabled\n");
+    }
+}
+
+static void M68K_WriteProtectRange(uint32_t low, uint32_t high)
+{
+    if (wp_pages == NULL)
+        return;
+
+    for (uint32_t page = low >> 12; page <= high >> 12; page++)
+    {
+        if ((wp_pages[page] & WP_PROTECTED) || (wp_pages[page] & WP_FAULTS) >= EMU68_WPROT_RETRIES)
+            continue;
+
+        /* Only pages which were writable before are ours. ROM and unmapped space are skipped */
+        if (mmu_protect_page(page << 12, 1) == 0)
+            wp_pages[page] |= WP_PROTECTED;
+        else
+            wp_pages[page] = EMU68_WPROT_RETRIES;
+    }
+}
+
+/* Returns 1 if no page of the unit was written since it was translated */
+int M68K_UnitProtected(struct M68KTranslationUnit *unit)
+{
+    if (wp_pages == NULL)
+        return 0;
+
+    for (uint32_t page = (uint32_t)(uintptr_t)unit->mt_M68kLow >> 12; page <= (uint32_t)(uintptr_t)unit->mt_M68kHigh >> 12; page++)
+    {
+        if (!(wp_pages[page] & WP_PROTECTED))
+            return 0;
+    }
+
+    return 1;
+}
+
+/* Invalidate entry point of the unit (also in the lookup table) and remove all direct links to it */
+void M68K_SoftFlushUnit(struct M68KTranslationUnit *unit)
+{
+    uintptr_t e = (uintptr_t)unit->mt_ARMEntryPoint;
+    e &= 0x00ffffffffffffffULL;
+    e |= 0xaa00000000000000ULL;
+    M68K_SetEntryPoint(unit, (void*)e);
+    M68K_UnlinkUnit(unit);
+}
+
+/*
+    Called on permission fault of a write access. If the page was protected by JIT, all units on it
+    are soft flushed (one of them may be executing right now) and the page becomes writable again.
+    Returns 1 if the fault was handled, the faulting store is then restarted.
+*/
+int M68K_WriteProtectFault(uint64_t far)
+{
+    uint32_t page = (uint32_t)far >> 12;
+
+    if (wp_pages == NULL || !(wp_pages[page] & WP_PROTECTED))
+        return 0;
+
+    if ((far >> 32) != 0 && (far >> 32) != 1 && (far >> 32) != 0xffffffff)
+        return 0;
+
+    wp_pages[page] = (wp_pages[page] & WP_FAULTS) + 1;
+    mmu_protect_page(page << 12, 0);
+
+    M68K_ForEachUnitInRange(page << 12, (page << 12) | 4095, M68K_SoftFlushUnit);
+
+    /* Do not let the dispatcher re-enter last unit directly */
+    asm volatile("msr tpidr_el1,%0"::"r"(0xffffffff));
+
+    __m68k_state->JIT_WPROT_FAULTS++;
+
+    return 1;
+}
+
+/*
+    Register the unit in the page map, one link for every m68k page the unit covers. Units within one
+    page use the link embedded in the unit. The span is limited to less than the size of the map, so
+    that a bucket never holds two links of one unit. Units spanning more pages go to the wide list.
+*/
+static void M68K_PageMapAdd(struct M68KTranslationUnit *unit)
+{
+    uint32_t first = (uint32_t)(uintptr_t)unit->mt_M68kLow >> 12;
+    uint32_t last = (uint32_t)(uintptr_t)unit->mt_M68kHigh >> 12;
+    uint32_t span = last - first + 1;
+
+    M68K_WriteProtectRange((uint32_t)(uintptr_t)unit->mt_M68kLow, (uint32_t)(uintptr_t)unit->mt_M68kHigh);
+
+    unit->mt_PageLinks = &unit->mt_PageLink;
+    unit->mt_PageCount = 1;
+
+    if (span > 1 && span <= EMU68_PAGEMAP_MAX_SPAN)
+    {
+        struct M68KPageLink *links = tlsf_malloc(tlsf, span * sizeof(struct M68KPageLink));
+
+        if (links != NULL)
+        {
+            unit->mt_PageLinks = links;
+            unit->mt_PageCount = span;
+        }
+    }
+
+    if (span != unit->mt_PageCount)
+    {
+        unit->mt_PageLink.pl_Page = EMU68_PAGEMAP_WIDE;
+        unit->mt_PageLink.pl_Unit = unit;
+        ADDHEAD(&page_wide, &unit->mt_PageLink.pl_Node);
+        return;
+    }
+
+    for (uint32_t i=0; i < span; i++)
+    {
+        struct M68KPageLink *link = &unit->mt_PageLinks[i];
+
+        link->pl_Page = first + i;
+        link->pl_Unit = unit;
+        ADDHEAD(&page_map[link->pl_Page & (EMU68_PAGEMAP_SIZE - 1)], &link->pl_Node);
+    }
+}
+
+static void M68K_PageMapRemove(struct M68KTranslationUnit *unit)
+{
+    for (uint32_t i=0; i < unit->mt_PageCount; i++)
+        REMOVE(&unit->mt_PageLinks[i].pl_Node);
+
+    if (unit->mt_PageLinks != &unit->mt_PageLink)
+        tlsf_free(tlsf, unit->mt_PageLinks);
+
+    unit->mt_PageLinks = NULL;
+    unit->mt_PageCount = 0;
+}
+
+/*
+    Call func for every unit whose m68k range overlaps with start..end (inclusive). Only the buckets
+    of affected pages and the list of wide units are searched. The function may release the unit.
+*/
+void M68K_ForEachUnitInRange(uint32_t start, uint32_t end, void (*func)(struct M68KTranslationUnit *))
+{
+    struct Node *n, *next;
+    uint32_t first = start >> 12;
+    uint32_t last = end >> 12;
+
+    if (last - first >= EMU68_PAGEMAP_SIZE)
+        last = first + EMU68_PAGEMAP_SIZE - 1;
+
+    for (uint32_t page = first; page <= last; page++)
+    {
+        ForeachNodeSafe(&page_map[page & (EMU68_PAGEMAP_SIZE - 1)], n, next)
+        {
+            struct M68KPageLink *link = (struct M68KPageLink *)n;
+            struct M68KTranslationUnit *u = link->pl_Unit;
+
+            if (link->pl_Page != page)
+                continue;
+
+            if ((uintptr_t)u->mt_M68kLow > end || (uintptr_t)u->mt_M68kHigh < start)
+                continue;
+
+            func(u);
+        }
+    }
+
+    ForeachNodeSafe(&page_wide, n, next)
+    {
+        struct M68KTranslationUnit *u = ((struct M68KPageLink *)n)->pl_Unit;
+
+        if ((uintptr_t)u->mt_M68kLow > end || (uintptr_t)u->mt_M68kHigh < start)
+            continue;
+
+        func(u);
+    }
+}
+
+static inline uint32_t M68K_UnitSize(struct M68KTranslationUnit *unit)
+{
+    return (4 * (unit->mt_ARMInsnCnt + 1) + 63 + sizeof(struct M68KTranslationUnit)) & ~63;
+}
+
+static inline struct JITRegion *M68K_UnitRegion(struct M68KTranslationUnit *unit)
+{
+    for (int i=0; i < jit_region_count; i++)
+    {
+        if ((uintptr_t)unit >= jit_region[i].jr_Base && (uintptr_t)unit < jit_region[i].jr_End)
+            return &jit_region[i];
+    }
+
+    return NULL;
+}
+
+/*
+    Return unit memory to its region. The space becomes a hole which is reclaimed when the whole
+    region is evicted.
+*/
+static void M68K_CacheFree(struct M68KTranslationUnit *unit)
+{
+    struct JITRegion *r = M68K_UnitRegion(unit);
+    uint32_t size = M68K_UnitSize(unit);
+
+    REMOVE(&unit->mt_RegionNode);
+
+    if (r != NULL)
+        r->jr_Holes += size;
+
+    jit_cache_used -= size;
+    __m68k_state->JIT_CACHE_HOLES += size;
+    __m68k_state->JIT_CACHE_FREE = jit_cache_size - jit_cache_used;
+}
+
+
+void M68K_ReleaseUnit(struct M68KTranslationUnit *unit)
+{
+    struct Node *n, *next;
+    uintptr_t slot = (uintptr_t)__m68k_state->JIT_CHAIN_SLOT & ~0x0000001000000000ULL;
+
+    M68K_UnlinkUnit(unit);
+
+    ForeachNodeSafe(&unit->mt_ChainOut, n, next)
+    {
+        struct M68KChainLink *link = (void *)((uintptr_t)n - __builtin_offsetof(struct M68KChainLink, cl_OutNode));
+
+        REMOVE(&link->cl_InNode);
+        REMOVE(&link->cl_OutNode);
+        tlsf_free(tlsf, link);
+    }
+
+    /* If the unit has just left through a not yet linked exit, forget about it */
+    if (slot >= (uintptr_t)&unit->mt_ARMCode[0] && slot < (uintptr_t)&unit->mt_ARMCode[unit->mt_ARMInsnCnt])
+        __m68k_state->JIT_CHAIN_SLOT = NULL;
+
+#if EMU68_TIERED_JIT
+    if (unit == promoted_unit)
+        promoted_unit = NULL;
+#endif
+
+    M68K_LookupRemove(unit);
+    M68K_PageMapRemove(unit);
+    REMOVE(&unit->mt_LRUNode);
+    M68K_CacheFree(unit);
+
+    __m68k_state->JIT_UNIT_COUNT--;
+}
+
+/*
+    Put the target unit into the inline cache of computed jump. If both entries of the cache are in
+    use, the older one is dropped. Entries are invalidated by M68K_UnlinkUnit, which writes the
+    never matching m68k address (1) into them
+*/
+static void M68K_FillInlineCache(uint32_t *rw_ic, struct M68KTranslationUnit *target)
+{
+    struct M68KTranslationUnit *source;
+    struct M68KChainLink *link;
+    struct Node *n;
+    uint64_t *entries = (uint64_t *)&rw_ic[2];
+    int idx;
+
+    source = (void *)((uintptr_t)(rw_ic - rw_ic[6]) - __builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode));
+
+    if (rw_ic[0] == 1)
+        idx = 0;
+    else if (rw_ic[1] == 1)
+        idx = 1;
+    else
+    {
+        struct M68KChainLink *l0 = NULL;
+        struct M68KChainLink *l1 = NULL;
+
+        ForeachNode(&source->mt_ChainOut, n)
+        {
+            link = (void *)((uintptr_t)n - __builtin_offsetof(struct M68KChainLink, cl_OutNode));
+            if (link->cl_Slot == &rw_ic[0])
+                l0 = link;
+            else if (link->cl_Slot == &rw_ic[1])
+                l1 = link;
+        }
+
+        /* Drop the older entry, move the recent one down */
+        if (l1)
+        {
+            REMOVE(&l1->cl_InNode);
+            REMOVE(&l1->cl_OutNode);
+            tlsf_free(tlsf, l1);
+        }
+        rw_ic[1] = 1;
+        entries[1] = entries[0];
+        rw_ic[1] = rw_ic[0];
+        if (l0)
+            l0->cl_Slot = &rw_ic[1];
+        rw_ic[0] = 1;
+
+        idx = 0;
+    }
+
+    link = tlsf_malloc(tlsf, sizeof(struct M68KChainLink));
+    if (link == NULL)
+        return;
+
+    link->cl_Slot = &rw_ic[idx];
+    link->cl_Insn = 1;
+
+    ADDHEAD(&target->mt_ChainIn, &link->cl_InNode);
+    ADDHEAD(&source->mt_ChainOut, &link->cl_OutNode);
+
+    /* Inline cache is data, no instruction cache maintenance is necessary */
+    entries[idx] = (uintptr_t)target->mt_ARMEntryPoint;
+    rw_ic[idx] = (uint32_t)(uintptr_t)target->mt_M68kAddress;
+}
+
+/*
+    Link the exit slot (as reported by the exit stub in JIT_CHAIN_SLOT) with the target unit. The
+    slot is replaced by a direct branch to the entry point of the target. If bit 0 of the slot
+    address is set, the exit was a computed jump and the target is put in its inline cache instead
+*/
+void M68K_LinkUnit(uint32_t *slot, struct M68KTranslationUnit *target)
+{
+    struct M68KTranslationUnit *source;
+    struct M68KChainLink *link;
+    uint32_t *rw_slot = (uint32_t *)((uintptr_t)slot & ~0x0000001000000000ULL);
+    uintptr_t entry = (uintptr_t)target->mt_ARMEntryPoint;
+
+    /* Only slots within the executable alias of JIT cache can be linked */
+    if (((uintptr_t)slot - 0xfffffff000000000ULL) >= (KERNEL_JIT_PAGES << 21))
+        return;
+
+    /* Target has a pending soft flush. Its entry has to be verified first, do not link */
+    if ((entry >> 56) != 0xff)
+        return;
+
+    if ((uintptr_t)slot & 1)
+    {
+        M68K_FillInlineCache((uint32_t *)((uintptr_t)rw_slot & ~1ULL), target);
+        return;
+    }
+
+    /* The exit went somewhere else (e.g. interrupt was processed in between) */
+    if (rw_slot[3] != (uint32_t)(uintptr_t)target->mt_M68kAddress)
+        return;
+
+    link = tlsf_malloc(tlsf, sizeof(struct M68KChainLink));
+    if (link == NULL)
+        return;
+
+    source = (void *)((uintptr_t)(rw_slot - rw_slot[4]) - __builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode));
+
+    link->cl_Slot = rw_slot;
+    link->cl_Insn = *rw_slot;
+
+    ADDHEAD(&target->mt_ChainIn, &link->cl_InNode);
+    ADDHEAD(&source->mt_ChainOut, &link->cl_OutNode);
+
+    *rw_slot = b((int32_t)(entry - (uintptr_t)slot) >> 2);
+    arm_flush_cache((uintptr_t)rw_slot, 4);
+    arm_icache_invalidate((uintptr_t)slot, 4);
+}
+
+#if EMU68_FAULT_PATCH
+/* Offset of the register in the frame saved by the fault stub, -1 if the register is not saved */
+static int fault_frame_slot(uint8_t reg)
+{
+    if (reg <= 18)
+        return reg * 8;
+    if (reg == 30)
+        return 152;
+    return -1;
+}
+
+static uint32_t *fault_get_reg(uint32_t *ptr, uint8_t dst, uint8_t reg)
+{
+    if (reg == 31)
+        *ptr++ = mov_reg(dst, 31);
+    else if (fault_frame_slot(reg) >= 0)
+        *ptr++ = ldr64_offset(31, dst, fault_frame_slot(reg));
+    else
+        *ptr++ = mov_reg(dst, reg);
+
+    return ptr;
+}
+
+static uint32_t *fault_restore_frame(uint32_t *ptr)
+{
+    *ptr++ = ldr64_offset(31, 0, 160);
+    *ptr++ = set_nzcv(0);
+    for (int i=2; i < 18; i += 2)
+        *ptr++ = ldp64(31, i, i + 1, i * 8);
+    *ptr++ = ldp64(31, 18, 30, 144);
+    *ptr++ = ldp64_postindex(31, 0, 1, 176);
+
+    return ptr;
+}
+
+/*
+    Find a free stub. If all are taken, the stubs which are not referenced by any patched site
+    anymore (the site was reverted together with its unit) are reused
+*/
+static uint32_t *M68K_AllocFaultStub()
+{
+    static uint8_t used[EMU68_FAULT_STUBS];
+    struct Node *n;
+
+    if (fault_stubs == NULL)
+        return NULL;
+
+    if (fault_stub_next == EMU68_FAULT_STUBS)
+    {
+        uintptr_t base = (uintptr_t)fault_stubs | 0x0000001000000000ULL;
+
+        for (int i=0; i < EMU68_FAULT_STUBS; i++)
+            used[i] = 0;
+
+        ForeachNode(&fault_links, n)
+        {
+            struct M68KChainLink *link = (void *)((uintptr_t)n - __builtin_offsetof(struct M68KChainLink, cl_InNode));
+            uintptr_t slot = (uintptr_t)link->cl_Slot | 0x0000001000000000ULL;
+            int32_t off = (int32_t)(INSN_TO_LE(*link->cl_Slot) << 6) >> 4;
+            uintptr_t idx = (slot + off - base) / (FAULT_STUB_SIZE * 4);
+
+            if (idx < EMU68_FAULT_STUBS)
+                used[idx] = 1;
+        }
+
+        for (int i=0; i < EMU68_FAULT_STUBS; i++)
+        {
+            if (!used[i])
+                return &fault_stubs[i * FAULT_STUB_SIZE];
+        }
+
+        return NULL;
+    }
+
+    return &fault_stubs[FAULT_STUB_SIZE * fault_stub_next++];
+}
+
+/*
+    Replace the load or store at given address of JIT code (executable alias) with a branch to a stub
+    which calls the bus helper and returns past the patched instruction. Only immediate offset forms
+    of byte, word and long accesses to general purpose registers are patched. The same site may later
+    access mapped memory (e.g. a copy loop running over chip and fast RAM), therefore the bus helper
+    is called for unmapped addresses below 16MB only. Any other access is done by the original
+    instruction kept in the stub, which may still fault and be handled as before.
+*/
+static void M68K_PatchFaultSite(uintptr_t pc)
+{
+    uint32_t *rw_site = (uint32_t *)(pc & ~0x0000001000000000ULL);
+    uint32_t insn = INSN_TO_LE(*rw_site);
+    struct M68KTranslationUnit *unit = NULL;
+    struct M68KChainLink *link;
+    uint32_t *stub, *ptr, *above_16m, *mapped;
+    uint8_t size = 1 << (insn >> 30);
+    uint8_t opc = (insn >> 22) & 3;
+    uint8_t rn = (insn >> 5) & 31;
+    uint8_t rt = insn & 31;
+    int32_t offset;
+    union {
+        uint64_t u64;
+        uint16_t u16[4];
+    } u;
+
+    if ((insn & 0x3f000000) == 0x39000000)
+        offset = ((insn >> 10) & 0xfff) * size;
+    else if ((insn & 0x3f200c00) == 0x38000000)
+        offset = (int32_t)(insn << 11) >> 23;
+    else
+        return;
+
+    if (size == 8 || rn == 31 || (size == 4 && opc > 1))
+        return;
+
+    for (int i=0; i < jit_region_count && unit == NULL; i++)
+    {
+        struct Node *n;
+
+        if ((uintptr_t)rw_site < jit_region[i].jr_Base || (uintptr_t)rw_site >= jit_region[i].jr_Top)
+            continue;
+
+        ForeachNode(&jit_region[i].jr_Units, n)
+        {
+            struct M68KTranslationUnit *u = (void *)((uintptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_RegionNode));
+
+            if (rw_site >= &u->mt_ARMCode[0] && rw_site < &u->mt_ARMCode[u->mt_ARMInsnCnt])
+            {
+                unit = u;
+                break;
+            }
+        }
+    }
+
+    if (unit == NULL)
+        return;
+
+    stub = M68K_AllocFaultStub();
+    if (stub == NULL)
+        return;
+
+    link = tlsf_malloc(tlsf, sizeof(struct M68KChainLink));
+    if (link == NULL)
+        return;
+
+    ptr = stub;
+
+    /* Save all registers which the C code may clobber, and the flags */
+    *ptr++ = stp64_preindex(31, 0, 1, -176);
+    for (int i=2; i < 18; i += 2)
+        *ptr++ = stp64(31, i, i + 1, i * 8);
+    *ptr++ = stp64(31, 18, 30, 144);
+    *ptr++ = get_nzcv(0);
+    *ptr++ = str64_offset(31, 0, 160);
+
+    ptr = fault_get_reg(ptr, 0, rn);
+    if (offset != 0)
+    {
+        *ptr++ = movw_immed_u16(2, offset & 0xffff);
+        *ptr++ = movt_immed_u16(2, (offset >> 16) & 0xffff);
+        *ptr++ = add_reg(0, 0, 2, LSL, 0);
+    }
+
+    /* Address translation fails for pages not mapped directly, these are on the bus */
+    *ptr++ = lsr(1, 0, 24);
+    above_16m = ptr;
+    *ptr++ = cbnz(1, 0);
+    *ptr++ = at_s1e1r(0);
+    *ptr++ = isb();
+    *ptr++ = get_par(1);
+    mapped = ptr;
+    *ptr++ = tbz(1, 0, 0);
+
+    if (opc == 0)
+    {
+        ptr = fault_get_reg(ptr, 1, rt);
+        u.u64 = (uintptr_t)SYSBusWrite;
+    }
+    else
+    {
+        u.u64 = (uintptr_t)SYSBusRead;
+    }
+
+    *ptr++ = mov_immed_u16(2, size, 0);
+    *ptr++ = mov64_immed_u16(3, u.u16[3], 0);
+    *ptr++ = movk64_immed_u16(3, u.u16[2], 1);
+    *ptr++ = movk64_immed_u16(3, u.u16[1], 2);
+    *ptr++ = movk64_immed_u16(3, u.u16[0], 3);
+    *ptr++ = blr(3);
+
+    /* Loads: extend the result as the original instruction did, then put it in place */
+    if (opc != 0 && rt != 31)
+    {
+        if (opc == 1)
+            *ptr++ = mov_reg(0, 0);
+        else if (opc == 2)
+            *ptr++ = (size == 1) ? sxtb64(0, 0) : sxth64(0, 0);
+        else if (opc == 3)
+            *ptr++ = (size == 1) ? sxtb(0, 0) : sxth(0, 0);
+
+        if (fault_frame_slot(rt) >= 0)
+            *ptr++ = str64_offset(31, 0, fault_frame_slot(rt));
+        else
+            *ptr++ = mov64_reg(rt, 0);
+    }
+
+    ptr = fault_restore_frame(ptr);
+    *ptr = b((int32_t)((pc + 4) - ((uintptr_t)ptr | 0x0000001000000000ULL)) >> 2);
+    ptr++;
+
+    /* Mapped memory or address above 16MB, execute the original instruction */
+    *above_16m = cbnz(1, ptr - above_16m);
+    *mapped = tbz(1, 0, ptr - mapped);
+
+    ptr = fault_restore_frame(ptr);
+    *ptr++ = *rw_site;
+    *ptr = b((int32_t)((pc + 4) - ((uintptr_t)ptr | 0x0000001000000000ULL)) >> 2);
+    ptr++;
+
+    arm_flush_cache((uintptr_t)stub, 4 * (ptr - stub));
+    arm_icache_invalidate((uintptr_t)stub | 0x0000001000000000ULL, 4 * (ptr - stub));
+
+    link->cl_Slot = rw_site;
+    link->cl_Insn = *rw_site;
+
+    ADDHEAD(&fault_links, &link->cl_InNode);
+    ADDHEAD(&unit->mt_ChainOut, &link->cl_OutNode);
+
+    *rw_site = b((int32_t)(((uintptr_t)stub | 0x0000001000000000ULL) - pc) >> 2);
+    arm_flush_cache((uintptr_t)rw_site, 4);
+    arm_icache_invalidate(pc, 4);
+
+    __m68k_state->JIT_FAULT_PATCHES++;
+}
+#endif
+
+/*
+    Called by the data abort handler for every load or store it has emulated. Sites in the JIT cache
+    which fault often are patched to call the bus helper directly.
+*/
+void M68K_FaultSite(uintptr_t pc)
+{
+#if EMU68_FAULT_PATCH
+    struct FaultSite *fs = &fault_sites[(pc >> 2) & (EMU68_FAULT_SITES - 1)];
+
+    /* Only sites within the executable alias of JIT cache can be patched */
+    if ((pc - 0xfffffff000000000ULL) >= (KERNEL_JIT_PAGES << 21))
+        return;
+
+    if (fs->fs_PC != pc)
+    {
+        fs->fs_PC = pc;
+        fs->fs_Count = 0;
+    }
+
+    if (++fs->fs_Count != EMU68_FAULT_PATCH_THRESHOLD)
+        return;
+
+#if EMU68_JIT_WORKER
+    /* Never wait for the worker in exception handler, the site will fault again anyway */
+    if (jit_worker_active && __atomic_test_and_set(&jit_lock, __ATOMIC_ACQUIRE))
+    {
+        fs->fs_Count--;
+        return;
+    }
+#endif
+
+    M68K_PatchFaultSite(pc);
+
+    M68K_UnlockJIT();
+#else
+    (void)pc;
+#endif
+}
+
+/*
+    Verify if the translated code has changed since the unit was created. In order
+    to do this MD5 sum of the block is compared with the previousy calculated one.
+
+    If th sums are not same, the block is removed form LRU cache and hashtable and memory
+    is released.
+
+    The function returns poitner to verified unit or NULL if the unit changed
+*/
+struct M68KTranslationUnit *M68K_VerifyUnit(struct M68KTranslationUnit *unit)
+{
+    if (unit)
+    {
+        uint32_t crc;
+
+        M68K_LockJIT();
+
+        crc = CalcCRC32(unit->mt_M68kLow, unit->mt_M68kHigh);
+
+        if (crc != unit->mt_CRC32)
+        {
+            M68K_ReleaseUnit(unit);
+
+            unit = NULL;
+        }
+
+        M68K_UnlockJIT();
+    }
+
+    return unit;
+}
+
+/*
+    Move the unit to new location within its region. All links from and to the unit are reverted
+    first, they are established again by the dispatcher when the unit gets used.
+*/
+static struct M68KTranslationUnit *M68K_MoveUnit(struct M68KTranslationUnit *unit, uintptr_t dest)
+{
+    struct M68KTranslationUnit *moved = (void *)dest;
+    struct M68KLookupEntry *e = M68K_LookupFind(unit);
+    uintptr_t slot = (uintptr_t)__m68k_state->JIT_CHAIN_SLOT & ~0x0000001000000000ULL;
+    uintptr_t entry = (uintptr_t)unit->mt_ARMEntryPoint;
+    uint32_t size = M68K_UnitSize(unit);
+    struct Node *n, *next;
+
+    M68K_UnlinkUnit(unit);
+
+    ForeachNodeSafe(&unit->mt_ChainOut, n, next)
+    {
+        struct M68KChainLink *link = (void *)((uintptr_t)n - __builtin_offsetof(struct M68KChainLink, cl_OutNode));
+
+        *link->cl_Slot = link->cl_Insn;
+
+        REMOVE(&link->cl_InNode);
+        REMOVE(&link->cl_OutNode);
+        tlsf_free(tlsf, link);
+    }
+
+    if (slot >= (uintptr_t)&unit->mt_ARMCode[0] && slot < (uintptr_t)&unit->mt_ARMCode[unit->mt_ARMInsnCnt])
+        __m68k_state->JIT_CHAIN_SLOT = NULL;
+
+    REMOVE(&unit->mt_LRUNode);
+    REMOVE(&unit->mt_RegionNode);
+    M68K_PageMapRemove(unit);
+
+    if (moved != unit)
+        memmove(moved, unit, size);
+
+    NEWLIST(&moved->mt_ChainIn);
+    NEWLIST(&moved->mt_ChainOut);
+    M68K_PageMapAdd(moved);
+
+    /* Keep the tag of a pending soft flush in the entry point */
+    entry = (entry & 0xff00000000000000ULL) |
+            (((uintptr_t)&moved->mt_ARMCode[0] | 0x0000001000000000ULL) & 0x00ffffffffffffffULL);
+    moved->mt_ARMEntryPoint = (void *)entry;
+    if (e != NULL)
+        e->le_ARMEntryPoint = (void *)entry;
+
+    ADDHEAD(&LRU, &moved->mt_LRUNode);
+
+#if EMU68_TIERED_JIT
+    if (unit == promoted_unit)
+        promoted_unit = moved;
+#endif
+
+    arm_flush_cache((uintptr_t)moved, size);
+    arm_icache_invalidate((uintptr_t)&moved->mt_ARMCode[0] | 0x0000001000000000ULL,
+        size - __builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode));
+
+    return moved;
+}
+
+/*
+    Evict the region. If keep is set, units which were used since the previous eviction are moved to
+    the beginning of the region instead of being released, as long as they do not take more than
+    1/EMU68_JIT_SURVIVOR_LIMIT of the region.
+*/
+static void M68K_EvictRegion(struct JITRegion *r, int keep)
+{
+    uintptr_t limit = r->jr_Base + (r->jr_End - r->jr_Base) / EMU68_JIT_SURVIVOR_LIMIT;
+    uintptr_t top = r->jr_Base;
+    struct List kept;
+    struct Node *n, *next;
+
+    NEWLIST(&kept);
+
+    ForeachNodeSafe(&r->jr_Units, n, next)
+    {
+        struct M68KTranslationUnit *unit = (void *)((uintptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_RegionNode));
+        uint32_t size = M68K_UnitSize(unit);
+        int hot = 0;
+
+#if EMU68_TIERED_JIT
+        /* Retired units (tier 0) were replaced by their second tier translation */
+        hot = unit->mt_Tier != 0 && (unit->mt_HotMark - unit->mt_HotCount) >= EMU68_JIT_SURVIVOR_ENTRIES;
+#endif
+
+        if (keep && hot && top + size <= limit)
+        {
+            unit = M68K_MoveUnit(unit, top);
+            unit->mt_HotMark = unit->mt_HotCount;
+            ADDTAIL(&kept, &unit->mt_RegionNode);
+            top += size;
+
+            __m68k_state->JIT_KEPT_UNITS++;
+        }
+        else
+        {
+            M68K_ReleaseUnit(unit);
+
+            __m68k_state->JIT_EVICT_UNITS++;
+        }
+    }
+
+    /* The region is compacted, all holes are gone */
+    __m68k_state->JIT_CACHE_HOLES -= r->jr_Holes;
+    r->jr_Holes = 0;
+    r->jr_Top = top;
+
+    NEWLIST(&r->jr_Units);
+    while ((n = REMHEAD(&kept)))
+        ADDTAIL(&r->jr_Units, n);
+
+    __m68k_state->JIT_EVICT_COUNT++;
+
+    /* The unit of last m68k PC could be gone or moved, force the full search in dispatcher */
+    asm volatile("msr tpidr_el1, %0"::"r"(0xffffffff));
+}
+
+/*
+    Allocate space for the unit. Memory is taken from current region until it is full. Then the next
+    region, which is the oldest one, is evicted and used for further allocations.
+*/
+static struct M68KTranslationUnit *M68K_CacheAlloc(uint32_t size)
+{
+    struct JITRegion *r = &jit_region[jit_region_current];
+    struct M68KTranslationUnit *unit;
+
+    if (r->jr_Top + size > r->jr_End)
+    {
+        jit_region_current = (jit_region_current + 1) % jit_region_count;
+        r = &jit_region[jit_region_current];
+
+        M68K_EvictRegion(r, 1);
+
+        if (r->jr_Top + size > r->jr_End)
+            M68K_EvictRegion(r, 0);
+
+        if (r->jr_Top + size > r->jr_End)
+            return NULL;
+    }
+
+    unit = (void *)r->jr_Top;
+    r->jr_Top += size;
+    ADDTAIL(&r->jr_Units, &unit->mt_RegionNode);
+
+    jit_cache_used += size;
+    __m68k_state->JIT_CACHE_FREE = jit_cache_size - jit_cache_used;
+
+    return unit;
+}
+
+uint32_t M68K_GetCacheSize()
+{
+    return jit_cache_size;
+}
+
+/*
+    Put an already translated unit into the instruction cache. Used to restore units from translation
+    snapshot. The template provides all m68k related fields of the unit, code has to contain all
+    instructions of the unit including the trailing end marker. Returns NULL if the unit could not be
+    added without evicting other units.
+*/
+struct M68KTranslationUnit *M68K_LoadUnit(struct M68KTranslationUnit *tmpl, uint32_t *code)
+{
+    struct M68KTranslationUnit *unit;
+    uint32_t line_length = 4 * (tmpl->mt_ARMInsnCnt + 1);
+    uint32_t unit_length = (line_length + 63 + sizeof(struct M68KTranslationUnit)) & ~63;
+    struct JITRegion *r = &jit_region[jit_region_current];
+
+    if (lookup_used >= EMU68_LOOKUP_LIMIT || M68K_LookupEntryPoint((uint32_t)(uintptr_t)tmpl->mt_M68kAddress) != NULL)
+        return NULL;
+
+    /* Snapshot may not push out anything, only the remaining space of current region is used */
+    if (r->jr_Top + unit_length > r->jr_End)
+        return NULL;
+
+    unit = M68K_CacheAlloc(unit_length);
+
+    unit->mt_ARMEntryPoint = (void *)((uintptr_t)&unit->mt_ARMCode[0] | 0x0000001000000000ULL);
+    unit->mt_M68kInsnCnt = tmpl->mt_M68kInsnCnt;
+    unit->mt_ARMInsnCnt = tmpl->mt_ARMInsnCnt;
+    unit->mt_UseCount = 0;
+    unit->mt_FetchCount = 0;
+    unit->mt_M68kAddress = tmpl->mt_M68kAddress;
+    unit->mt_M68kLow = tmpl->mt_M68kLow;
+    unit->mt_M68kHigh = tmpl->mt_M68kHigh;
+    unit->mt_CRC32 = tmpl->mt_CRC32;
+    unit->mt_PrologueSize = tmpl->mt_PrologueSize;
+    unit->mt_EpilogueSize = tmpl->mt_EpilogueSize;
+    unit->mt_Conditionals = tmpl->mt_Conditionals;
+    unit->mt_Tier = tmpl->mt_Tier;
+    unit->mt_HotCount = unit->mt_Tier == 1 ? EMU68_TIER2_THRESHOLD : 0x7fffffff;
+    unit->mt_HotMark = unit->mt_HotCount;
+    unit->mt_ExitCount = tmpl->mt_ExitCount;
+    unit->mt_LoopCount = 0;
+    for (uint32_t i=0; i < tmpl->mt_ExitCount; i++)
+    {
+        unit->mt_Exits[i].ep_M68kPC = tmpl->mt_Exits[i].ep_M68kPC;
+        unit->mt_Exits[i].ep_Taken = 0;
+    }
+    NEWLIST(&unit->mt_ChainIn);
+    NEWLIST(&unit->mt_ChainOut);
+    DuffCopy(&unit->mt_ARMCode[0], code, line_length / 4);
+
+    ADDHEAD(&LRU, &unit->mt_LRUNode);
+    M68K_LookupInsert((uint32_t)(uintptr_t)unit->mt_M68kAddress, unit->mt_ARMEntryPoint);
+    M68K_PageMapAdd(unit);
+
+    __m68k_state->JIT_UNIT_COUNT++;
+
+    arm_flush_cache((uintptr_t)&unit->mt_ARMCode, line_length);
+    arm_icache_invalidate((intptr_t)unit->mt_ARMEntryPoint, line_length);
+
+    return unit;
+}
+
+/* Fill the unit with code which was just translated from m68kcodeptr */
+static void M68K_FillUnit(struct M68KTranslationUnit *unit, uint16_t *m68kcodeptr, int tier, uintptr_t line_length)
+{
+    unit->mt_ARMEntryPoint = &unit->mt_ARMCode[0];
+    unit->mt_ARMEntryPoint = (void *)((uintptr_t)unit->mt_ARMEntryPoint | 0x0000001000000000ULL);
+    unit->mt_M68kInsnCnt = insn_count;
+    unit->mt_ARMInsnCnt = line_length/4 - 1;
+    unit->mt_UseCount = 0;
+    unit->mt_FetchCount = 0;
+    unit->mt_M68kAddress = m68kcodeptr;
+    unit->mt_M68kLow = m68k_low;
+    unit->mt_M68kHigh = m68k_high;
+    unit->mt_CRC32 = CalcCRC32(m68k_low, m68k_high);
+    unit->mt_PrologueSize = prologue_size;
+    unit->mt_EpilogueSize = epilogue_size;
+    unit->mt_Conditionals = conditionals_count;
+    unit->mt_Tier = tier;
+    unit->mt_HotCount = tier == 1 ? EMU68_TIER2_THRESHOLD : 0x7fffffff;
+    unit->mt_HotMark = unit->mt_HotCount;
+    unit->mt_ExitCount = exit_count;
+    unit->mt_LoopCount = 0;
+    for (uint32_t i=0; i < exit_count; i++)
+    {
+        unit->mt_Exits[i].ep_M68kPC = exit_profile[i].ep_M68kPC;
+        unit->mt_Exits[i].ep_Taken = 0;
+    }
+    NEWLIST(&unit->mt_ChainIn);
+    NEWLIST(&unit->mt_ChainOut);
+    DuffCopy(&unit->mt_ARMCode[0], temporary_arm_code, line_length/4);
+}
+
+void M68K_LockJIT()
+{
+#if EMU68_JIT_WORKER
+    if (jit_worker_active)
+        while(__atomic_test_and_set(&jit_lock, __ATOMIC_ACQUIRE)) { asm volatile("yield"); }
+#endif
+}
+
+void M68K_UnlockJIT()
+{
+#if EMU68_JIT_WORKER
+    if (jit_worker_active)
+        __atomic_clear(&jit_lock, __ATOMIC_RELEASE);
+#endif
+}
+
+#if EMU68_JIT_WORKER
+void M68K_EnableWorker()
+{
+    jit_worker_active = 1;
+    kprintf("[JIT] Background translation enabled\n");
+}
+
+/* Queue successors of the unit which was just translated. Called with the lock held */
+static void M68K_RequestSuccessors()
+{
+    uint32_t head = jit_request_head;
+
+    if (!jit_worker_active)
+        return;
+
+    for (int i=0; i < jit_successor_count; i++)
+    {
+        uint32_t pc = (uint32_t)(uintptr_t)jit_successors[i];
+
+        if (head - jit_request_tail >= EMU68_JIT_WORKER_QUEUE)
+            break;
+
+        if (M68K_LookupEntryPoint(pc) == NULL)
+            jit_requests[head++ & (EMU68_JIT_WORKER_QUEUE - 1)] = pc;
+    }
+
+    if (head != jit_request_head)
+    {
+        __atomic_store_n(&jit_request_head, head, __ATOMIC_RELEASE);
+        asm volatile("sev");
+    }
+}
+
+/*
+    Translate the unit on the worker core. The unit is not entered into lookup table, it waits on
+    jit_ready list for the dispatcher. Only code in memory mapped directly is translated, so that
+    the worker never reads from the bus, and no unit is ever evicted to make space for the new one.
+    The translator is limited to the page of the unit and the next one, which were checked here.
+*/
+static void M68K_WorkerTranslate(uint32_t pc)
+{
+    struct JITRegion *r = &jit_region[jit_region_current];
+    struct M68KTranslationUnit *unit;
+    uintptr_t line_length, unit_length;
+    struct Node *n;
+
+    if (M68K_LookupEntryPoint(pc) != NULL || lookup_used >= EMU68_LOOKUP_LIMIT / 2)
+        return;
+
+    if (mmu_virt2phys(pc & ~4095) == (uintptr_t)-1 || mmu_virt2phys((pc & ~4095) + 4096) == (uintptr_t)-1)
+        return;
+
+    ForeachNode(&jit_ready, n)
+    {
+        unit = (void *)((uintptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+
+        if ((uint32_t)(uintptr_t)unit->mt_M68kAddress == pc)
+            return;
+    }
+
+    /* Translator may not leave the verified pages, all code outside them is left to the dispatcher */
+    code_window_low = pc & ~4095;
+    code_window_high = (pc & ~4095) + 8192;
+
+    line_length = M68K_Translate((uint16_t *)(uintptr_t)pc, EMU68_TIERED_JIT ? 1 : 2);
+
+    code_window_low = 0;
+    code_window_high = 0xffffffff;
+
+    unit_length = (line_length + 63 + sizeof(struct M68KTranslationUnit)) & ~63;
+
+    if (r->jr_Top + unit_length > r->jr_End)
+        return;
+
+    unit = M68K_CacheAlloc(unit_length);
+    M68K_FillUnit(unit, (uint16_t *)(uintptr_t)pc, EMU68_TIERED_JIT ? 1 : 2, line_length);
+    unit->mt_PageLinks = &unit->mt_PageLink;
+    unit->mt_PageCount = 0;
+
+    arm_flush_cache((uintptr_t)&unit->mt_ARMCode, line_length);
+    arm_icache_invalidate((intptr_t)unit->mt_ARMEntryPoint, line_length);
+
+    ADDTAIL(&jit_ready, &unit->mt_LRUNode);
+    __m68k_state->JIT_UNIT_COUNT++;
+}
+
+/*
+    Move all units made by the worker into the lookup table. Units of code which has changed since
+    (or was translated by the dispatcher in the meantime) are released. Returns the unit of given
+    address, if there was one.
+*/
+static struct M68KTranslationUnit *M68K_AdoptUnits(uint16_t *m68kcodeptr)
+{
+    struct M68KTranslationUnit *found = NULL;
+    struct Node *n;
+
+    if (IsListEmpty(&jit_ready))
+        return NULL;
+
+    /* Code was written by other core */
+    asm volatile("isb");
+
+    while ((n = REMHEAD(&jit_ready)))
+    {
+        struct M68KTranslationUnit *unit = (void *)((uintptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+
+        ADDHEAD(&LRU, &unit->mt_LRUNode);
+
+        if (lookup_used >= EMU68_LOOKUP_LIMIT ||
+            M68K_LookupEntryPoint((uint32_t)(uintptr_t)unit->mt_M68kAddress) != NULL ||
+            CalcCRC32(unit->mt_M68kLow, unit->mt_M68kHigh) != unit->mt_CRC32)
+        {
+            M68K_ReleaseUnit(unit);
+            continue;
+        }
+
+        M68K_LookupInsert((uint32_t)(uintptr_t)unit->mt_M68kAddress, unit->mt_ARMEntryPoint);
+        M68K_PageMapAdd(unit);
+
+        __m68k_state->JIT_WORKER_UNITS++;
+
+        if (unit->mt_M68kAddress == m68kcodeptr)
+            found = unit;
+    }
+
+    return found;
+}
+
+/* Main loop of the translation worker, runs on CPU1 */
+void M68K_TranslationWorker()
+{
+    kprintf("[JIT] Translation worker started\n");
+
+    while(1)
+    {
+        uint32_t tail = jit_request_tail;
+        uint32_t pc;
+
+        if (tail == __atomic_load_n(&jit_request_head, __ATOMIC_ACQUIRE))
+        {
+            asm volatile("wfe");
+            continue;
+        }
+
+        pc = jit_requests[tail & (EMU68_JIT_WORKER_QUEUE - 1)];
+        __atomic_store_n(&jit_request_tail, tail + 1, __ATOMIC_RELEASE);
+
+        M68K_LockJIT();
+        M68K_WorkerTranslate(pc);
+        M68K_UnlockJIT();
+    }
+}
+#endif
+
+/*
+    Translate M68K code and put it into new unit of the instruction cache. Units of first tier count
+    their executions and are translated again as second tier once they become hot.
+*/
+static struct M68KTranslationUnit *M68K_NewUnit(uint16_t *m68kcodeptr, int tier)
+{
+    struct M68KTranslationUnit *unit = NULL; //, *n;
+    uint16_t *orig_m68kcodeptr = m68kcodeptr;
+    
+    int debug = 0;
+
+    if ((uint32_t)(uintptr_t)m68kcodeptr >= debug_range_min && (uint32_t)(uintptr_t)m68kcodeptr <= debug_range_max) {
+        debug = globalDebug();
+    }
+
+    if (debug > 2)
+        kprintf("[ICache] GetTranslationUnit(%08x)\n[ICache] Hash: 0x%05x\n", (void*)m68kcodeptr, (int)M68K_LookupHash((uint32_t)(uintptr_t)m68kcodeptr));
+
+    if (unit == NULL)
+    {
+        uintptr_t line_length = M68K_Translate(m68kcodeptr, tier);
+
+        uintptr_t unit_length = (line_length + 63 + sizeof(struct M68KTranslationUnit)) & ~63;
+
+        do {
+            unit = M68K_CacheAlloc(unit_length);
+
+            if (unit == NULL && debug > 0)
+            {
+                kprintf("[ICache] Requested block was %d bytes long\n", unit_length);
             }
         } while(unit == NULL);
 
-        unit->mt_ARMEntryPoint = &unit->mt_ARMCode[0];
-        unit->mt_ARMEntryPoint = (void *)((uintptr_t)unit->mt_ARMEntryPoint | 0x0000001000000000ULL);
-        unit->mt_M68kInsnCnt = insn_count;
-        unit->mt_ARMInsnCnt = arm_insn_count;
-        unit->mt_UseCount = 0;
-        unit->mt_FetchCount = 0;
-        unit->mt_M68kAddress = orig_m68kcodeptr;
-        unit->mt_M68kLow = m68k_low;
-        unit->mt_M68kHigh = m68k_high;
-        unit->mt_CRC32 = CalcCRC32(m68k_low, m68k_high);
-        unit->mt_PrologueSize = prologue_size;
-        unit->mt_EpilogueSize = epilogue_size;
-        unit->mt_Conditionals = conditionals_count;
-        DuffCopy(&unit->mt_ARMCode[0], temporary_arm_code, line_length/4);
+        /* Keep the lookup table sparse enough for short probe sequences */
+        while (lookup_used >= EMU68_LOOKUP_LIMIT)
+        {
+            struct Node *n = GetTail(&LRU);
+
+            if (n == NULL)
+                break;
+
+            M68K_ReleaseUnit((void *)((char *)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode)));
+
+            asm volatile("msr tpidr_el1, %0"::"r"(0xffffffff));
+        }
+
+        M68K_FillUnit(unit, orig_m68kcodeptr, tier, line_length);
 
         ADDHEAD(&LRU, &unit->mt_LRUNode);
-        ADDHEAD(&ICache[hash], &unit->mt_HashNode);
+        M68K_LookupInsert((uint32_t)(uintptr_t)unit->mt_M68kAddress, unit->mt_ARMEntryPoint);
+        M68K_PageMapAdd(unit);
 
         __m68k_state->JIT_UNIT_COUNT++;
         __m68k_state->JIT_CACHE_MISS++;
@@ -721,6 +2413,10 @@ struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
         arm_flush_cache((uintptr_t)&unit->mt_ARMCode, line_length);
         arm_icache_invalidate((intptr_t)unit->mt_ARMEntryPoint, line_length);
 
+#if EMU68_JIT_WORKER
+        M68K_RequestSuccessors();
+#endif
+
         if (debug)
         {
             kprintf("-- ARM Code dump --\n");
@@ -758,6 +2454,131 @@ struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
     return unit;
 }
 
+/*
+    Get M68K code unit from the instruction cache. Return NULL if code was not found and needs to be
+    translated first.
+
+    If the code was found, update its position in the LRU cache.
+*/
+struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
+{
+    struct M68KTranslationUnit *unit = NULL;
+
+    M68K_LockJIT();
+#if EMU68_JIT_WORKER
+    unit = M68K_AdoptUnits(m68kcodeptr);
+#endif
+    if (unit == NULL)
+        unit = M68K_NewUnit(m68kcodeptr, EMU68_TIERED_JIT ? 1 : 2);
+    M68K_UnlockJIT();
+
+    return unit;
+}
+
+#if EMU68_TIERED_JIT
+/*
+    Translate hot unit again with more aggressive settings: maximal unit size, deeper branch
+    inlining, more loop unrolling and longer CCR scan. The new unit replaces the old one in lookup
+    table. Entry of the old unit is redirected to the new code and the old unit is moved to the end
+    of LRU list, so that it is discarded first. Returns entry point where the execution continues.
+*/
+void *M68K_PromoteUnit(struct M68KTranslationUnit *unit)
+{
+    struct M68KState *ctx = __m68k_state;
+    struct M68KTranslationUnit *hot;
+    uint32_t jc = ctx->JIT_CONTROL;
+    uint32_t jc2 = ctx->JIT_CONTROL2;
+    uint32_t range = (jc >> JCCB_INLINE_RANGE) & JCCB_INLINE_RANGE_MASK;
+    uint32_t loops = (jc >> JCCB_LOOP_COUNT) & JCCB_LOOP_COUNT_MASK;
+    uint32_t ccr = (jc2 >> JC2B_CCR_SCAN_DEPTH) & JC2_CCR_SCAN_MASK;
+
+    /* Counter of second tier unit has expired, just start it again */
+    if (unit->mt_Tier != 1)
+    {
+        unit->mt_HotCount = 0x7fffffff;
+        unit->mt_HotMark = unit->mt_HotCount;
+        return unit->mt_ARMEntryPoint;
+    }
+
+    /* Never go below settings of the first tier */
+    if (range < EMU68_TIER2_INLINE_RANGE)
+        range = EMU68_TIER2_INLINE_RANGE;
+    if (loops != 0 && loops < EMU68_TIER2_LOOP_COUNT)
+        loops = EMU68_TIER2_LOOP_COUNT;
+    if (ccr < EMU68_TIER2_CCR_SCAN_DEPTH)
+        ccr = EMU68_TIER2_CCR_SCAN_DEPTH;
+
+    /* The settings are changed for a moment, the worker may not translate with them */
+    M68K_LockJIT();
+
+    ctx->JIT_CONTROL = jc & ~((JCCB_INSN_DEPTH_MASK << JCCB_INSN_DEPTH) |
+                              (JCCB_LOOP_COUNT_MASK << JCCB_LOOP_COUNT) |
+                              (JCCB_INLINE_RANGE_MASK << JCCB_INLINE_RANGE));
+    ctx->JIT_CONTROL |= (EMU68_TIER2_INSN_DEPTH & JCCB_INSN_DEPTH_MASK) << JCCB_INSN_DEPTH;
+    ctx->JIT_CONTROL |= loops << JCCB_LOOP_COUNT;
+    ctx->JIT_CONTROL |= range << JCCB_INLINE_RANGE;
+    ctx->JIT_CONTROL2 = (jc2 & ~(JC2_CCR_SCAN_MASK << JC2B_CCR_SCAN_DEPTH)) | (ccr << JC2B_CCR_SCAN_DEPTH);
+
+    /* Move the unit to the head of LRU so that it is not evicted while new one is translated */
+    REMOVE(&unit->mt_LRUNode);
+    ADDHEAD(&LRU, &unit->mt_LRUNode);
+
+    promoted_unit = unit;
+    hot = M68K_NewUnit(unit->mt_M68kAddress, 2);
+
+    ctx->JIT_CONTROL = jc;
+    ctx->JIT_CONTROL2 = jc2;
+
+    /* The unit might have been moved or released while space for the new one was allocated */
+    if (promoted_unit != NULL)
+    {
+        unit = promoted_unit;
+        uint32_t *rw_entry = &unit->mt_ARMCode[0];
+        uintptr_t entry = (uintptr_t)rw_entry | 0x0000001000000000ULL;
+
+        promoted_unit = NULL;
+        unit->mt_Tier = 0;
+
+        /* Links into old unit will be re-established with the new one by dispatcher */
+        M68K_UnlinkUnit(unit);
+
+        *rw_entry = b(((intptr_t)hot->mt_ARMEntryPoint - (intptr_t)entry) >> 2);
+        arm_flush_cache((uintptr_t)rw_entry, 4);
+        arm_icache_invalidate(entry, 4);
+
+        REMOVE(&unit->mt_LRUNode);
+        ADDTAIL(&LRU, &unit->mt_LRUNode);
+    }
+
+    M68K_UnlockJIT();
+
+    return hot->mt_ARMEntryPoint;
+}
+
+/*
+    Called from the hot counter of the unit with x0 pointing to the unit. Registers of m68k which
+    are not preserved by the C ABI are saved here. The code continues at returned entry point and
+    never returns to the old unit, which could have been evicted in the meantime.
+*/
+void __attribute__((used)) stub_PromoteUnit()
+{
+    asm volatile(
+"       .globl  trampoline_promote_unit     \n"
+"trampoline_promote_unit:                   \n"
+"       stp     x13, x14, [sp, #-64]!       \n"
+"       stp     x15, x16, [sp, #16]         \n"
+"       stp     x17, x18, [sp, #32]         \n"
+"       str     x30, [sp, #48]              \n"
+"       bl      M68K_PromoteUnit            \n"
+"       ldp     x15, x16, [sp, #16]         \n"
+"       ldp     x17, x18, [sp, #32]         \n"
+"       ldr     x30, [sp, #48]              \n"
+"       ldp     x13, x14, [sp], #64         \n"
+"       br      x0                          \n"
+    );
+}
+#endif
+
 void M68K_InitializeCache()
 {
     kprintf("[ICache] Initializing caches\n");
@@ -765,16 +2586,171 @@ void M68K_InitializeCache()
     kprintf("[ICache] Setting up LRU\n");
     NEWLIST(&LRU);
 
+#if EMU68_JIT_WORKER
+    NEWLIST(&jit_ready);
+#endif
+
+    kprintf("[ICache] Setting up page map\n");
+    for (int i=0; i < EMU68_PAGEMAP_SIZE; i++)
+        NEWLIST(&page_map[i]);
+    NEWLIST(&page_wide);
+
+#if EMU68_FAULT_PATCH
+    NEWLIST(&fault_links);
+    fault_stubs = tlsf_malloc(jit_tlsf, EMU68_FAULT_STUBS * FAULT_STUB_SIZE * 4);
+    fault_stub_next = 0;
+#endif
+
     kprintf("[ICache] Setting up ICache\n");
 
     temporary_arm_code = tlsf_malloc(jit_tlsf, (JCCB_INSN_DEPTH_MASK + 1) * 16 * 64);
-    __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
     kprintf("[ICache] Temporary code at %p\n", temporary_arm_code);
+
+    /* Split rest of the JIT memory into regions, leave some space for the allocator itself */
+    uint32_t region_size = ((tlsf_get_free_size(jit_tlsf) - 65536) / EMU68_JIT_REGIONS) & ~4095;
+
+    jit_region_count = 0;
+    jit_region_current = 0;
+    jit_cache_size = 0;
+    jit_cache_used = 0;
+
+    for (int i=0; i < EMU68_JIT_REGIONS; i++)
+    {
+        void *base = tlsf_malloc_aligned(jit_tlsf, region_size, 4096);
+
+        if (base == NULL)
+            break;
+
+        jit_region[i].jr_Base = (uintptr_t)base;
+        jit_region[i].jr_Top = (uintptr_t)base;
+        jit_region[i].jr_End = (uintptr_t)base + region_size;
+        jit_region[i].jr_Holes = 0;
+        NEWLIST(&jit_region[i].jr_Units);
+
+        jit_region_count++;
+        jit_cache_size += region_size;
+    }
+
+    kprintf("[ICache] JIT cache split into %d regions of %d KiB\n", jit_region_count, region_size / 1024);
     local_state = tlsf_malloc(tlsf, sizeof(struct M68KLocalState)*(JCCB_INSN_DEPTH_MASK + 1)*2);
     kprintf("[ICache] ICache array at %p\n", ICache);
 
-    for (int i=0; i < 65536; i++)
-        NEWLIST(&ICache[i]);
+    for (int i=0; i < EMU68_LOOKUP_SIZE; i++)
+    {
+        ICache[i].le_M68kAddress = M68K_LOOKUP_FREE;
+        ICache[i].le_ARMEntryPoint = NULL;
+    }
+    lookup_used = 0;
+}
+
+/*
+    Measure latency of the lookup table at growing occupancy. The table is filled with synthetic
+    entries at random even addresses, hits and misses are timed with the cycle counter. Works on
+    an empty table only (before emulation starts), the table is cleared afterwards.
+*/
+void M68K_LookupBenchmark()
+{
+    static const int load[] = { 10, 25, 50, 65, 75 };
+    const uint32_t iter_count = 1000000;
+    uint32_t *keys;
+
+    if (lookup_used != 0)
+    {
+        kprintf("[ICache] Lookup benchmark needs empty table, skipping\n");
+        return;
+    }
+
+    keys = tlsf_malloc(tlsf, sizeof(uint32_t) * EMU68_LOOKUP_LIMIT);
+    if (keys == NULL)
+        return;
+
+    kprintf("[ICache] Lookup benchmark, table of %d entries, %d entries per cache line\n",
+        EMU68_LOOKUP_SIZE, (int)(64 / sizeof(struct M68KLookupEntry)));
+
+    for (unsigned l=0; l < sizeof(load) / sizeof(load[0]); l++)
+    {
+        uint32_t count = (EMU68_LOOKUP_SIZE / 100) * load[l];
+        uint32_t seed = 0x4d363800 + l;
+        uint64_t cnt1, cnt2, calib, hit, miss;
+        uint64_t probe_sum = 0;
+        uint32_t probe_max = 0;
+
+        if (count > EMU68_LOOKUP_LIMIT)
+            count = EMU68_LOOKUP_LIMIT;
+
+        for (uint32_t i=0; i < count; i++)
+        {
+            uint32_t pc;
+
+            do {
+                seed = seed * 1103515245 + 12345;
+                pc = (seed >> 4) & 0x0ffffffe;
+            } while(M68K_LookupEntryPoint(pc) != NULL);
+
+            keys[i] = pc;
+            M68K_LookupInsert(pc, (void *)(uintptr_t)(0xfffffff000000000ULL | pc));
+        }
+
+        /* Probe length of each key, measured from its home slot */
+        for (uint32_t i=0; i < count; i++)
+        {
+            uint32_t idx = M68K_LookupHash(keys[i]);
+            uint32_t len = 1;
+
+            while(ICache[idx].le_M68kAddress != keys[i])
+            {
+                idx = (idx + 1) & EMU68_LOOKUP_MASK;
+                len++;
+            }
+
+            probe_sum += len;
+            if (len > probe_max)
+                probe_max = len;
+        }
+
+        asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt1));
+        for (uint32_t i=0, k=0; i < iter_count; i++)
+        {
+            asm volatile(""::"r"(keys[k]));
+            if (++k == count) k = 0;
+        }
+        asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt2));
+        calib = cnt2 - cnt1;
+
+        asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt1));
+        for (uint32_t i=0, k=0; i < iter_count; i++)
+        {
+            void *entry = M68K_LookupEntryPoint(keys[k]);
+            asm volatile(""::"r"(entry));
+            if (++k == count) k = 0;
+        }
+        asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt2));
+        hit = cnt2 - cnt1 - calib;
+
+        /* Odd addresses are never present in the table */
+        asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt1));
+        for (uint32_t i=0, k=0; i < iter_count; i++)
+        {
+            void *entry = M68K_LookupEntryPoint(keys[k] | 1);
+            asm volatile(""::"r"(entry));
+            if (++k == count) k = 0;
+        }
+        asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt2));
+        miss = cnt2 - cnt1 - calib;
+
+        kprintf("[ICache]   load %2d%% (%6d entries): avg probe %f, max probe %d, hit %f cycles, miss %f cycles\n",
+            load[l], count, (double)probe_sum / (double)count, probe_max,
+            (double)hit / (double)iter_count, (double)miss / (double)iter_count);
+
+        for (int i=0; i < EMU68_LOOKUP_SIZE; i++)
+        {
+            ICache[i].le_M68kAddress = M68K_LOOKUP_FREE;
+            ICache[i].le_ARMEntryPoint = NULL;
+        }
+        lookup_used = 0;
+    }
+
+    tlsf_free(tlsf, keys);
 }
 
 void M68K_DumpStats()
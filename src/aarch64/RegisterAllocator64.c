@@ -166,9 +166,29 @@ static uint8_t mod_FPCR = 0;
 static uint8_t reg_FPSR = 0xff;
 static uint8_t mod_FPSR = 0;
 
+/*
+    CTX, CC, FPCR and FPSR are cached in temporary registers for as long as possible. Remember
+    the m68k instruction which used each of them last, so that the allocator can take back the
+    register of a value which is not needed anymore instead of failing.
+*/
+enum { CACHED_CTX, CACHED_CC, CACHED_FPCR, CACHED_FPSR, CACHED_COUNT };
+
+static uint32_t insn_number = 1;
+static uint32_t last_use[CACHED_COUNT];
+
+void RA_BeginInstruction()
+{
+    insn_number++;
+}
+
 uint8_t RA_TryCTX(uint32_t **ptr)
 {
     (void)ptr;
+
+    /* Caller uses the register in this instruction, it cannot be taken back */
+    if (reg_CTX != 0xff)
+        last_use[CACHED_CTX] = insn_number;
+
     return reg_CTX;
 }
 
@@ -181,6 +201,8 @@ uint8_t RA_GetCTX(uint32_t **ptr)
         (*ptr)++;
     }
 
+    last_use[CACHED_CTX] = insn_number;
+
     return reg_CTX;
 }
 
@@ -205,6 +227,8 @@ uint8_t RA_GetFPCR(uint32_t **ptr)
         mod_FPCR = 0;
     }
 
+    last_use[CACHED_FPCR] = insn_number;
+
     return reg_FPCR;
 }
 
@@ -250,6 +274,8 @@ uint8_t RA_GetFPSR(uint32_t **ptr)
         mod_FPSR = 0;
     }
 
+    last_use[CACHED_FPSR] = insn_number;
+
     return reg_FPSR;
 }
 
@@ -299,6 +325,8 @@ uint8_t RA_GetCC(uint32_t **ptr)
         mod_CC = 0;
     }
 
+    last_use[CACHED_CC] = insn_number;
+
     return reg_CC;
 }
 
@@ -364,39 +392,59 @@ static uint8_t __int_arm_alloc_reg()
     return 0xff;
 }
 
-uint8_t RA_AllocARMRegister(uint32_t **arm_stream)
+/*
+    Select cached value which can give its register back. Values used by the current m68k
+    instruction are never taken, since the emitter may still hold their register. Among the others
+    the clean ones go first (releasing them emits no code), then the least recently used.
+*/
+static int __int_arm_select_victim()
 {
-    uint8_t reg = __int_arm_alloc_reg();
-
-    if (reg != 0xff)
-        return reg;
-
-    kprintf("!!!warning - flushing regs!\n");
+    const uint8_t regs[CACHED_COUNT] = { reg_CTX, reg_CC, reg_FPCR, reg_FPSR };
+    const uint8_t dirty[CACHED_COUNT] = { 0, mod_CC, mod_FPCR, mod_FPSR };
+    int victim = -1;
 
-    RA_FlushFPCR(arm_stream);
-
-    reg = __int_arm_alloc_reg();
-
-    if (reg != 0xff)
-        return reg;
-
-    RA_FlushFPSR(arm_stream);
-
-    reg = __int_arm_alloc_reg();
-
-    if (reg != 0xff)
-        return reg;
+    for (int i=0; i < CACHED_COUNT; i++)
+    {
+        if (regs[i] == 0xff || last_use[i] == insn_number)
+            continue;
 
-    RA_FlushCC(arm_stream);
+        if (victim == -1 || dirty[i] < dirty[victim] ||
+            (dirty[i] == dirty[victim] && last_use[i] < last_use[victim]))
+        {
+            victim = i;
+        }
+    }
 
-    reg = __int_arm_alloc_reg();
+    return victim;
+}
 
-    if (reg != 0xff)
-        return reg;
+uint8_t RA_AllocARMRegister(uint32_t **arm_stream)
+{
+    uint8_t reg;
 
-    kprintf("[JIT] ARM Register allocator exhausted!!!\n");
+    while ((reg = __int_arm_alloc_reg()) == 0xff)
+    {
+        switch (__int_arm_select_victim())
+        {
+            case CACHED_CTX:
+                RA_FlushCTX(arm_stream);
+                break;
+            case CACHED_CC:
+                RA_FlushCC(arm_stream);
+                break;
+            case CACHED_FPCR:
+                RA_FlushFPCR(arm_stream);
+                break;
+            case CACHED_FPSR:
+                RA_FlushFPSR(arm_stream);
+                break;
+            default:
+                kprintf("[JIT] ARM Register allocator exhausted!!!\n");
+                return 0xff;
+        }
+    }
 
-    return 0xff;
+    return reg;
 }
 
 
@@ -0,0 +1,239 @@
+/*
+    Copyright © 2019 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include "lsdecode.h"
+
+/* Entry: form and flags in bits 7:0, log2 of size in bits 10:8 */
+static uint16_t ls_table[2048];
+static int ls_table_ready;
+
+static uint16_t ls_classify(uint32_t opcode)
+{
+    uint8_t sz = opcode >> 30;
+    uint8_t opc = (opcode >> 22) & 3;
+
+    /* Integer loads and stores with unsigned offset, 9-bit offset or register offset */
+    if ((opcode & 0x3e000000) == 0x38000000)
+    {
+        uint8_t form = (opcode & 0x01000000) ? LS_UIMM12 : (opcode & 0x00200000) ? LS_REGOFF : LS_IMM9;
+
+        switch (opc)
+        {
+            case 0:
+                return form | (sz << 8);
+            case 1:
+                return form | LSF_LOAD | (sz << 8);
+            case 2:
+                if (sz == 3)
+                    return LS_PREFETCH;
+                return form | LSF_LOAD | LSF_SEXT64 | (sz << 8);
+            default:
+                if (sz >= 2)
+                    return LS_INVALID;
+                return form | LSF_LOAD | LSF_SEXT32 | (sz << 8);
+        }
+    }
+
+    /* Single and double precision FP registers */
+    if ((opcode & 0x3e000000) == 0x3c000000)
+    {
+        uint8_t form = (opcode & 0x01000000) ? LS_UIMM12 : (opcode & 0x00200000) ? LS_REGOFF : LS_IMM9;
+
+        if (sz < 2 || (opc & 2))
+            return LS_INVALID;
+
+        return form | LSF_FP | (opc ? LSF_LOAD : 0) | (sz << 8);
+    }
+
+    /* Integer pairs: STP/LDP of 32 and 64 bit registers, LDPSW */
+    if ((opcode & 0x3e000000) == 0x28000000)
+    {
+        uint8_t load = (opcode >> 22) & 1;
+
+        switch (sz)
+        {
+            case 0:
+                return LS_PAIR | (load ? LSF_LOAD : 0) | (2 << 8);
+            case 1:
+                return load ? (LS_PAIR | LSF_LOAD | LSF_SEXT64 | (2 << 8)) : LS_INVALID;
+            case 2:
+                return LS_PAIR | (load ? LSF_LOAD : 0) | (3 << 8);
+            default:
+                return LS_INVALID;
+        }
+    }
+
+    /* LDR (literal), LDRSW (literal) and PRFM (literal) */
+    if ((opcode & 0x3f000000) == 0x18000000)
+    {
+        switch (sz)
+        {
+            case 0:
+                return LS_LITERAL | LSF_LOAD | (2 << 8);
+            case 1:
+                return LS_LITERAL | LSF_LOAD | (3 << 8);
+            case 2:
+                return LS_LITERAL | LSF_LOAD | LSF_SEXT64 | (2 << 8);
+            default:
+                return LS_PREFETCH;
+        }
+    }
+
+    /* Exclusive (bit 23 clear) and ordered (bit 23 set) loads and stores. No exclusive monitor on the bus */
+    if ((opcode & 0x3f200000) == 0x08000000)
+    {
+        uint8_t flags = (opcode & 0x00400000) ? LSF_LOAD : (opcode & 0x00800000) ? 0 : LSF_STATUS;
+
+        return LS_BASE | flags | (sz << 8);
+    }
+
+    return LS_INVALID;
+}
+
+/*
+    Returns 1 if the opcode is a supported load or store and puts its fields in *li. Otherwise li_Form
+    is LS_INVALID
+*/
+int SYSDecodeLoadStore(uint32_t opcode, struct LSInsn *li)
+{
+    uint16_t e;
+
+    if (!ls_table_ready)
+    {
+        for (uint32_t i=0; i < 2048; i++)
+            ls_table[i] = ls_classify(i << 21);
+        ls_table_ready = 1;
+    }
+
+    e = ls_table[opcode >> 21];
+
+    li->li_Form = e & LS_FORM;
+    li->li_Flags = e & ~LS_FORM & 0xff;
+    li->li_Size = 1 << ((e >> 8) & 7);
+    li->li_Writeback = LS_WB_NONE;
+    li->li_Rt = opcode & 31;
+    li->li_Rt2 = (opcode >> 10) & 31;
+    li->li_Rn = (opcode >> 5) & 31;
+    li->li_Rm = (opcode >> 16) & 31;
+    li->li_Extend = 0;
+    li->li_Shift = 0;
+    li->li_Offset = 0;
+
+    switch (li->li_Form)
+    {
+        case LS_UIMM12:
+            li->li_Offset = ((opcode >> 10) & 0xfff) * li->li_Size;
+            break;
+
+        case LS_IMM9:
+            li->li_Offset = (int32_t)(opcode << 11) >> 23;
+            switch ((opcode >> 10) & 3)
+            {
+                case 1:
+                    li->li_Writeback = LS_WB_POST;
+                    break;
+                case 3:
+                    li->li_Writeback = LS_WB_PRE;
+                    break;
+                case 2:     /* Unprivileged access */
+                    break;
+            }
+            break;
+
+        case LS_REGOFF:
+            if (((opcode >> 10) & 3) != 2)
+            {
+                li->li_Form = LS_INVALID;
+                return 0;
+            }
+            li->li_Extend = (opcode >> 13) & 7;
+            li->li_Shift = (opcode & 0x1000) ? ((e >> 8) & 7) : 0;
+            break;
+
+        case LS_PAIR:
+            li->li_Offset = ((int32_t)(opcode << 10) >> 25) * (int32_t)li->li_Size;
+            switch ((opcode >> 23) & 3)
+            {
+                case 1:
+                    li->li_Writeback = LS_WB_POST;
+                    break;
+                case 3:
+                    li->li_Writeback = LS_WB_PRE;
+                    break;
+            }
+            break;
+
+        case LS_INVALID:
+            return 0;
+    }
+
+    return 1;
+}
+
+/* Address accessed by the instruction, or FAR if it cannot be computed from registers */
+uint64_t SYSEffectiveAddress(struct LSInsn *li, uint64_t *ctx, uint64_t far)
+{
+    uint64_t addr = ctx[li->li_Rn];
+
+    switch (li->li_Form)
+    {
+        case LS_UIMM12:
+        case LS_IMM9:
+        case LS_PAIR:
+            if (li->li_Writeback != LS_WB_POST)
+                addr += (int64_t)li->li_Offset;
+            break;
+
+        case LS_REGOFF:
+        {
+            uint64_t rm = li->li_Rm == 31 ? 0 : ctx[li->li_Rm];
+
+            switch (li->li_Extend)
+            {
+                case 0b010: // UXTW
+                    rm &= 0xffffffffULL;
+                    break;
+                case 0b110: // SXTW
+                    rm = (int64_t)(int32_t)rm;
+                    break;
+            }
+
+            addr += rm << li->li_Shift;
+            break;
+        }
+
+        case LS_LITERAL:
+            addr = far;
+            break;
+    }
+
+    return addr;
+}
+
+/* Zero or sign extend the value read from memory as the instruction would do */
+uint64_t SYSExtendValue(struct LSInsn *li, uint64_t value)
+{
+    switch (li->li_Size)
+    {
+        case 1:
+            value = (li->li_Flags & LSF_SEXT64) ? (uint64_t)(int64_t)(int8_t)value :
+                    (li->li_Flags & LSF_SEXT32) ? (uint32_t)(int32_t)(int8_t)value : (uint8_t)value;
+            break;
+        case 2:
+            value = (li->li_Flags & LSF_SEXT64) ? (uint64_t)(int64_t)(int16_t)value :
+                    (li->li_Flags & LSF_SEXT32) ? (uint32_t)(int32_t)(int16_t)value : (uint16_t)value;
+            break;
+        case 4:
+            value = (li->li_Flags & LSF_SEXT64) ? (uint64_t)(int64_t)(int32_t)value : (uint32_t)value;
+            break;
+    }
+
+    return value;
+}
@@ -548,6 +548,114 @@ void mmu_map(uintptr_t phys, uintptr_t virt, uintptr_t length, uint32_t attr_low
 "       isb                         \n");
 }
 
+/*
+    Change write permission of a single 4K page in the 0..4GB range. A 2MB block is split into 4K
+    pages first. Returns previous state of the page (1 if it was read-only) or -1 if the page is
+    not mapped. TLB entries of the page and both of its mirrors are invalidated.
+*/
+int mmu_protect_page(uintptr_t virt, int readonly)
+{
+    struct mmu_page *tbl;
+    uint64_t entry;
+    int idx_l1 = (virt >> 30) & 0x1ff;
+    int idx_l2 = (virt >> 21) & 0x1ff;
+    int idx_l3 = (virt >> 12) & 0x1ff;
+    int was_readonly;
+
+    if (virt >= 0x100000000ULL)
+        return -1;
+
+    asm volatile("mrs %0, TTBR0_EL1":"=r"(tbl));
+    tbl = (struct mmu_page *)((uintptr_t)tbl + PHYS_VIRT_OFFSET);
+
+    entry = tbl->mp_entries[idx_l1];
+    if ((entry & 3) != 3)
+        return -1;
+
+    tbl = (struct mmu_page *)((entry & 0x7ffffff000) + PHYS_VIRT_OFFSET);
+    entry = tbl->mp_entries[idx_l2];
+
+    if ((entry & 3) == 1)
+    {
+        /* 2MB page. Split it and set the permission on the 4K page */
+        was_readonly = (entry & MMU_READ_ONLY) != 0;
+
+        if (was_readonly != !!readonly)
+        {
+            struct mmu_page *l3 = get_4k_page();
+            uint64_t va = (virt >> 12) & 0xffe00;
+
+            if (l3 == NULL)
+                return -1;
+
+            /* Build the L3 directory with all attributes of the block, including the upper ones */
+            for (int i=0; i < 512; i++)
+                l3->mp_entries[i] = 3 | (entry & 0xfff0000000000ffcULL) | ((entry & 0x0000ffffffe00000ULL) + ((uint64_t)i << 12));
+
+            if (readonly)
+                l3->mp_entries[idx_l3] |= MMU_READ_ONLY;
+            else
+                l3->mp_entries[idx_l3] &= ~(uint64_t)MMU_READ_ONLY;
+
+            /*
+                Break-before-make: the block may be held in TLBs of other cores, so it has to be
+                invalidated everywhere before the table is put in its place. The block is visible at
+                0..4GB, 4..8GB and in the topmost 4GB of kernel space.
+            */
+            tbl->mp_entries[idx_l2] = 0;
+
+            asm volatile(
+"       dsb     ishst               \n"
+"       tlbi    vaae1is, %0         \n"
+"       tlbi    vaae1is, %1         \n"
+"       tlbi    vaae1is, %2         \n"
+"       dsb     ish                 \n"
+"       isb                         \n"
+            ::"r"(va), "r"(va | 0x100000), "r"(va | 0xffffff00000ULL));
+
+            tbl->mp_entries[idx_l2] = 3 | ((uintptr_t)l3 - PHYS_VIRT_OFFSET);
+
+            asm volatile(
+"       dsb     ishst               \n"
+"       isb                         \n");
+        }
+
+        return was_readonly;
+    }
+    else if ((entry & 3) != 3)
+        return -1;
+
+    tbl = (struct mmu_page *)((entry & 0x7ffffff000) + PHYS_VIRT_OFFSET);
+    entry = tbl->mp_entries[idx_l3];
+
+    if ((entry & 3) != 3)
+        return -1;
+
+    was_readonly = (entry & MMU_READ_ONLY) != 0;
+
+    if (was_readonly != !!readonly)
+    {
+        uint64_t va = (virt >> 12) & 0xfffff;
+
+        if (readonly)
+            tbl->mp_entries[idx_l3] = entry | MMU_READ_ONLY;
+        else
+            tbl->mp_entries[idx_l3] = entry & ~(uint64_t)MMU_READ_ONLY;
+
+        /* The page is visible at 0..4GB, 4..8GB and in the topmost 4GB of kernel space */
+        asm volatile(
+"       dsb     ishst               \n"
+"       tlbi    vaae1is, %0         \n"
+"       tlbi    vaae1is, %1         \n"
+"       tlbi    vaae1is, %2         \n"
+"       dsb     ish                 \n"
+"       isb                         \n"
+        ::"r"(va), "r"(va | 0x100000), "r"(va | 0xffffff00000ULL));
+    }
+
+    return was_readonly;
+}
+
 void mmu_unmap(uintptr_t virt, uintptr_t length)
 {
     (void)virt;
@@ -404,6 +404,7 @@ void secondary_boot(void)
     uint64_t tmp;
     of_node_t *e = NULL;
     int async_log = 0;
+    int jit_worker = 0;
 
     asm volatile("mrs %0, MPIDR_EL1":"=r"(cpu_id));
    
@@ -438,6 +439,9 @@ void secondary_boot(void)
             {
                 if (strstr(prop->op_value, "async_log"))
                     async_log = 1;
+
+                if (find_token(prop->op_value, "jit_worker"))
+                    jit_worker = 1;
             }
         }
     }
@@ -449,6 +453,8 @@ void secondary_boot(void)
     {
         if (async_log)
             serial_writer();
+        else if (jit_worker)
+            M68K_TranslationWorker();
     }
     else if (cpu_id == 2)
     {
@@ -461,6 +467,9 @@ void secondary_boot(void)
     }
 #else
     (void)async_log;
+
+    if (cpu_id == 1 && jit_worker)
+        M68K_TranslationWorker();
 #endif
 
     while(1) { asm volatile("wfe"); }
@@ -524,6 +533,12 @@ uint32_t firmware_size = 0;
 uint32_t cs_dist = 1;
 int fast_page0 = 0;
 
+#ifdef PISTORM
+/* Translation snapshot found in initrd after the ROM image */
+static void *jit_snapshot = NULL;
+static uint32_t jit_snapshot_size = 0;
+#endif
+
 void boot(void *dtree)
 {
     uintptr_t kernel_top_virt = ((uintptr_t)boot + (KERNEL_SYS_PAGES << 21)) & ~((1 << 21)-1);
@@ -642,6 +657,28 @@ void boot(void *dtree)
                 cs_dist = cs;
             }
 
+#if PISTORM_WRITE_BUFFER
+            if ((tok = find_token(prop->op_value, "wb_depth=")))
+            {
+                extern uint32_t wb_depth;
+                uint32_t depth = 0;
+
+                for (int i=0; i < 4; i++)
+                {
+                    if (tok[9 + i] < '0' || tok[9 + i] > '9')
+                        break;
+
+                    depth = depth * 10 + tok[9 + i] - '0';
+                }
+
+                if (depth > 4096)
+                    depth = 4096;
+
+                /* Round down to power of two, never below the default */
+                if (depth >= PISTORM_WRITE_BUFFER_SIZE)
+                    wb_depth = 1 << (31 - __builtin_clz(depth));
+            }
+#endif
 
             if (find_token(prop->op_value, "dbf_slowdown") || find_token(prop->op_value, "DBF"))
             {
@@ -1355,6 +1392,23 @@ void boot(void *dtree)
     {
         extern uint32_t rom_mapped;
 
+        /* Translation snapshot may be appended to the ROM image, keep it for M68K_StartEmu */
+        for (uint32_t rom_size = 262144; rom_size <= 2097152; rom_size <<= 1)
+        {
+            if (initramfs_size > rom_size + 4 && *(uint32_t *)((uintptr_t)initramfs_loc + rom_size) == M68K_SNAPSHOT_MAGIC)
+            {
+                jit_snapshot_size = initramfs_size - rom_size;
+                jit_snapshot = tlsf_malloc(tlsf, jit_snapshot_size);
+                if (jit_snapshot)
+                {
+                    memcpy(jit_snapshot, (void *)((uintptr_t)initramfs_loc + rom_size), jit_snapshot_size);
+                    kprintf("[BOOT] Found translation snapshot of %d bytes after the ROM\n", jit_snapshot_size);
+                }
+                initramfs_size = rom_size;
+                break;
+            }
+        }
+
         kprintf("[BOOT] Loading ROM from %p, size %d\n", initramfs_loc, initramfs_size);
         mmu_map(0xf80000, 0xf80000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
             
@@ -1691,31 +1745,31 @@ void  __attribute__((used)) stub_FindUnit()
     asm volatile(
 "       .align  8                           \n"
 "FindUnit:                                  \n"
+"       eor     w0, w%[reg_pc], w%[reg_pc], lsr #%[bits] \n" // Hash is ((pc ^ (pc >> bits)) >> 1) & mask
+"       ubfx    w0, w0, #1, #%[bits]        \n"
 "       adrp    x4, ICache                  \n"
 "       add     x4, x4, :lo12:ICache        \n"
-"       and     x0, x%[reg_pc], 0x1fffe0    \n" // Hash is (address >> 5) & 0xffff !!!!
-"       ldr     x0, [x4, x0]                \n"
-"       b       1f                          \n"
-"3:                                         \n" // 2 -> 5
+"1:     add     x1, x4, x0, lsl #4          \n"
+"       ldr     w5, [x1]                    \n"
 "       cmp     w5, w%[reg_pc]              \n"
 "       b.eq    2f                          \n"
-"       mov     x0, x4                      \n"
-"1:     ldr     x4, [x0]                    \n"
-"       ldr     x5, [x0, #32]               \n"
-"       cbnz    x4, 3b                      \n"
-"       mov     x0, #0                      \n"
-"4:     ret                                 \n"
-"2:     ldp     x6, x4, [x0, #16]           \n"
-"       ldr     x5, [x4, #8]                \n"
-"       cbz     x5, 4b                      \n"
-"       stp     x4, x5, [x0, #16]           \n"
-"       add     x7, x0, #0x10               \n" // 4 -> 7
-"       str     x7, [x5]                    \n"
-"       stp     x6, x7, [x4]                \n"
-"       str     x4, [x6, #8]                \n"
+"       cmn     w5, #1                      \n" // Free entry terminates the search
+"       b.eq    3f                          \n"
+"       add     w0, w0, #1                  \n"
+"       and     w0, w0, #%[mask]            \n"
+"       b       1b                          \n"
+"3:     mov     x0, #0                      \n"
+"       ret                                 \n"
+"2:     ldr     x0, [x1, #8]                \n" // Get unit from its entry point
+"       orr     x0, x0, #0xff00000000000000 \n"
+"       bic     x0, x0, #0x0000001000000000 \n"
+"       sub     x0, x0, #%[code]            \n"
 "       ret                                 \n"
 
-::[reg_pc]"i"(REG_PC));
+::[reg_pc]"i"(REG_PC),
+  [bits]"i"(EMU68_LOOKUP_BITS),
+  [mask]"i"(EMU68_LOOKUP_MASK),
+  [code]"i"(__builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode)));
 }
 
 #ifdef PISTORM
@@ -1772,34 +1826,25 @@ void  __attribute__((used)) stub_ExecutionLoop()
 "       b       1b                          \n"
 "       .align  6                           \n"
 "13:                                        \n"
-"       and     x0, x%[reg_pc], 0x1fffe0    \n" // Hash is (address >> 5) & 0xffff !!!!
+"       eor     w0, w%[reg_pc], w%[reg_pc], lsr #%[bits] \n" // Hash is ((pc ^ (pc >> bits)) >> 1) & mask
+"       ubfx    w0, w0, #1, #%[bits]        \n"
 "       adrp    x4, ICache                  \n"
 "       add     x4, x4, :lo12:ICache        \n"
-"       ldr     x0, [x4, x0]                \n"
-"       b       51f                         \n"
-"53:                                        \n" // 2 -> 5
+"51:    add     x1, x4, x0, lsl #4          \n" // Four entries per cache line, {m68k PC, ARM entry}
+"       ldr     w5, [x1]                    \n"
 "       cmp     w5, w%[reg_pc]              \n"
 "       b.eq    52f                         \n"
-"       mov     x0, x4                      \n"
-"51:    ldr     x4, [x0]                    \n"
-"       ldr     x5, [x0, #32]               \n" // Fetch PC address now, we assume that the search was successful
-"       cbnz    x4, 53b                     \n"
-"       b 5f                                \n"
-"52:    ldp     x6, x4, [x0, #16]           \n"
-"       ldr     x5, [x4, #8]                \n"
-"       cbz     x5, 55f                     \n"
-"       stp     x4, x5, [x0, #16]           \n"
-"       add     x7, x0, #0x10               \n" // 4 -> 7
-"       str     x7, [x5]                    \n"
-"       stp     x6, x7, [x4]                \n"
-"       str     x4, [x6, #8]                \n"
-
-"55:                                        \n"
-"       ldr     x12, [x0, #%[offset]]       \n"
+"       cmn     w5, #1                      \n" // Free entry terminates the search
+"       b.eq    5f                          \n"
+"       add     w0, w0, #1                  \n"
+"       and     w0, w0, #%[mask]            \n"
+"       b       51b                         \n"
+"52:    ldr     x12, [x1, #8]               \n"
 #if EMU68_LOG_FETCHES
-"       ldr     x1, [x0, #%[fcount]]        \n"
+"       bic     x0, x12, #0x0000001000000000\n"
+"       ldr     x1, [x0, #-%[fdiff]]        \n"
 "       add     x1, x1, #1                  \n"
-"       str     x1, [x0, #%[fcount]]        \n"
+"       str     x1, [x0, #-%[fdiff]]        \n"
 #endif
 "       msr     TPIDR_EL1, x%[reg_pc]       \n"
 #if EMU68_LOG_USES
@@ -2033,6 +2078,10 @@ void  __attribute__((used)) stub_ExecutionLoop()
  [sr_s]"i"(SR_S),
  [sr_t01]"i"(SR_T0 | SR_T1),
  [fcount]"i"(__builtin_offsetof(struct M68KTranslationUnit, mt_FetchCount)),
+ [fdiff]"i"(__builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode) -
+        __builtin_offsetof(struct M68KTranslationUnit, mt_FetchCount)),
+ [bits]"i"(EMU68_LOOKUP_BITS),
+ [mask]"i"(EMU68_LOOKUP_MASK),
  [cacr]"i"(__builtin_offsetof(struct M68KState, CACR)),
  [offset]"i"(__builtin_offsetof(struct M68KTranslationUnit, mt_ARMEntryPoint)),
  [diff]"i"(__builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode) - 
@@ -2087,8 +2136,8 @@ void M68K_StartEmu(void *addr, void *fdt)
     __m68k.PC = BE32(*((uint32_t*)addr+1));
     __m68k.SR = BE16(SR_S | SR_IPL);
     __m68k.FPCR = 0;
-    __m68k.JIT_CACHE_TOTAL = tlsf_get_total_size(jit_tlsf);
-    __m68k.JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+    __m68k.JIT_CACHE_TOTAL = M68K_GetCacheSize();
+    __m68k.JIT_CACHE_FREE = __m68k.JIT_CACHE_TOTAL;
     __m68k.JIT_UNIT_COUNT = 0;
     __m68k.JIT_SOFTFLUSH_THRESH = EMU68_WEAK_CFLUSH_LIMIT;
     __m68k.JIT_CONTROL = EMU68_WEAK_CFLUSH ? JCCF_SOFT : 0;
@@ -2101,6 +2150,13 @@ void M68K_StartEmu(void *addr, void *fdt)
     __m68k.JIT_CONTROL2 |= ((cs_dist - 1) << JC2B_CHIP_SLOWDOWN_RATIO);
     __m68k.JIT_CONTROL2 |= blitwait ? JC2F_BLITWAIT : 0;
 
+    if (jit_snapshot != NULL)
+    {
+        M68K_SnapshotLoad(jit_snapshot, jit_snapshot_size);
+        tlsf_free(tlsf, jit_snapshot);
+        jit_snapshot = NULL;
+    }
+
 #else
     __m68k.D[0].u32 = BE32((uint32_t)pitch);
     __m68k.D[1].u32 = BE32((uint32_t)fb_width);
@@ -2113,8 +2169,8 @@ void M68K_StartEmu(void *addr, void *fdt)
     __m68k.ISP.u32 = BE32(BE32(__m68k.ISP.u32) - 4);
     __m68k.SR = BE16(SR_S | SR_IPL);
     __m68k.FPCR = 0;
-    __m68k.JIT_CACHE_TOTAL = tlsf_get_total_size(jit_tlsf);
-    __m68k.JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+    __m68k.JIT_CACHE_TOTAL = M68K_GetCacheSize();
+    __m68k.JIT_CACHE_FREE = __m68k.JIT_CACHE_TOTAL;
     __m68k.JIT_UNIT_COUNT = 0;
     __m68k.JIT_SOFTFLUSH_THRESH = EMU68_WEAK_CFLUSH_LIMIT;
     __m68k.JIT_CONTROL = EMU68_WEAK_CFLUSH ? JCCF_SOFT : 0;
@@ -2151,6 +2207,28 @@ void M68K_StartEmu(void *addr, void *fdt)
             if (strstr(prop->op_value, "disassemble"))
                 disasm = 1;
 
+            if (strstr(prop->op_value, "lookup_bench"))
+                M68K_LookupBenchmark();
+
+            if (strstr(prop->op_value, "crc_bench"))
+                CalcCRC32Benchmark();
+
+#ifdef PISTORM
+            if (strstr(prop->op_value, "bus_bench"))
+                SYSBusBenchmark();
+#endif
+
+            if (find_token(prop->op_value, "jit_wprot"))
+                M68K_EnableWriteProtect();
+
+            /* Worker runs on CPU1, which is taken by asynchronous log on PiStorm */
+#ifdef PISTORM
+            if (find_token(prop->op_value, "jit_worker") && !strstr(prop->op_value, "async_log"))
+#else
+            if (find_token(prop->op_value, "jit_worker"))
+#endif
+                M68K_EnableWorker();
+
 #ifdef PISTORM
             extern uint32_t swap_df0_with_dfx;
             extern uint32_t move_slow_to_chip;
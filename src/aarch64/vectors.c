@@ -15,6 +15,7 @@
 #include "tlsf.h"
 #include "M68k.h"
 #include "cache.h"
+#include "lsdecode.h"
 
 #define FULL_CONTEXT 1
 
@@ -139,6 +140,8 @@ void  __attribute__((used)) __stub_vectors()
 "       .balign 0x80                    \n"
 "curr_el_spx_irq:                       \n" // The exception handler for an IRQ exception from 
 "       stp x0, x1, [sp, -16]!          \n" // the current EL using the current SP.
+"       mrs x0, PMOVSCLR_EL0            \n" // Overflow of PMU counter 0 is a profiler sample
+"       tbnz w0, #0, ProfileIRQ         \n"
 "       mrs x0, SPSR_EL1                \n" // Get SPSR
 "       orr x0, x0, #0x080              \n" // Disable IRQ interrupt so that we are not disturbed on return
 "       msr SPSR_EL1, x0                \n"
@@ -256,6 +259,14 @@ void  __attribute__((used)) __stub_vectors()
         LOAD_CONTEXT
 "       eret                            \n"
 "                                       \n"
+"ProfileIRQ:                            \n" // Profiler sample, pass interrupted PC and saved
+"       ldp x0, x1, [sp], #16           \n" // registers to M68K_ProfileSample
+        SAVE_CONTEXT
+"       mrs x0, ELR_EL1                 \n"
+"       mov x1, sp                      \n"
+"       bl M68K_ProfileSample           \n"
+"       b ExceptionExit                 \n"
+"                                       \n"
 "       .section .text                  \n"
 :
 :[pint]"i"(__builtin_offsetof(struct M68KState, INT.ARM)),
@@ -265,27 +276,6 @@ void  __attribute__((used)) __stub_vectors()
 
 );}
 
-static int getOPsize(uint32_t opcode)
-{
-    int size = 0;
-    switch (opcode & 0xc0000000)
-    {
-        case 0x00000000:
-            size = 1;
-            break;
-        case 0x40000000:
-            size = 2;
-            break;
-        case 0x80000000:
-            size = 4;
-            break;
-        case 0xc0000000:
-            size = 8;
-            break;
-    }
-    return size;
-}
-
 #undef D
 #define D(x) /* x */
 
@@ -718,6 +708,95 @@ int SYSReadValFromAddr(uint64_t *value, uint64_t *value2, int size, uint64_t far
 }
 #endif
 
+/*
+    Entry points for JIT code accessing chip registers at addresses known at translation time. They
+    go through the same path as the data abort handler, so that all side effects of the access are
+    kept, but the cost of taking the exception and decoding the faulting instruction is avoided.
+*/
+uint32_t SYSBusRead(uint32_t address, uint32_t size)
+{
+    uint64_t value = 0;
+
+    SYSReadValFromAddr(&value, NULL, size, address);
+
+    return value;
+}
+
+void SYSBusWrite(uint32_t address, uint32_t value, uint32_t size)
+{
+    SYSWriteValToAddr(value, 0, size, address);
+}
+
+#ifdef PISTORM
+static inline uint32_t SYSTrappedRead(uintptr_t address, uint32_t size)
+{
+    switch (size)
+    {
+        case 1:
+            return *(volatile uint8_t *)address;
+        case 2:
+            return *(volatile uint16_t *)address;
+        default:
+            return *(volatile uint32_t *)address;
+    }
+}
+
+/*
+    Compare the cost of chip register accesses which trap into the data abort handler with direct
+    calls of the bus helpers. Reads go to VPOSR/VHPOSR and writes to the NO-OP register of custom
+    chips, so that neither of them has side effects. Both paths include the latency of Amiga bus.
+*/
+void SYSBusBenchmark()
+{
+    static const uint8_t sizes[] = { 1, 2, 4 };
+    const uint32_t iter_count = 10000;
+    const uint32_t rd_address = 0xdff004;
+    const uint32_t wr_address = 0xdff1fe;
+    uint64_t cnt1, cnt2, trapped, direct;
+    uint32_t value = 0;
+
+    kprintf("[JIT:SYS] Benchmark of bus helpers, reads from %08x, writes to %08x\n", rd_address, wr_address);
+    kprintf("[JIT:SYS]   access  trapped  direct  (cycles per access)\n");
+
+    for (unsigned i=0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt1));
+        for (uint32_t j=0; j < iter_count; j++)
+        {
+            value = SYSTrappedRead(rd_address, sizes[i]);
+            asm volatile(""::"r"(value));
+        }
+        asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt2));
+        trapped = cnt2 - cnt1;
+
+        asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt1));
+        for (uint32_t j=0; j < iter_count; j++)
+        {
+            value = SYSBusRead(rd_address, sizes[i]);
+            asm volatile(""::"r"(value));
+        }
+        asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt2));
+        direct = cnt2 - cnt1;
+
+        kprintf("[JIT:SYS]   read.%c  %7d  %6d\n", "bw?l"[sizes[i] - 1], (uint32_t)(trapped / iter_count), (uint32_t)(direct / iter_count));
+    }
+
+    asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt1));
+    for (uint32_t j=0; j < iter_count; j++)
+        *(volatile uint16_t *)(uintptr_t)wr_address = 0;
+    asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt2));
+    trapped = cnt2 - cnt1;
+
+    asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt1));
+    for (uint32_t j=0; j < iter_count; j++)
+        SYSBusWrite(wr_address, 0, 2);
+    asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt2));
+    direct = cnt2 - cnt1;
+
+    kprintf("[JIT:SYS]   write.w %7d  %6d\n", (uint32_t)(trapped / iter_count), (uint32_t)(direct / iter_count));
+}
+#endif
+
 #undef D
 #define D(x) /* x  */
 
@@ -747,7 +826,7 @@ int SYSValidateUnit(uint32_t vector, uint64_t *ctx, uint64_t elr, uint64_t spsr,
 
     if (unit)
     {
-        unit->mt_ARMEntryPoint = (void*)corrected_far;
+        M68K_SetEntryPoint(unit, (void*)corrected_far);
         elr = corrected_far;
         asm volatile("msr ELR_EL1, %0"::"r"(elr));
         return 1;
@@ -1064,439 +1143,133 @@ void set_fpn_as_double(int fpn, uint64_t value) {
     }
 }
 
-int SYSPageFaultWriteHandler(uint32_t vector, uint64_t *ctx, uint64_t elr, uint64_t spsr, uint64_t esr, uint64_t far)
+static uint64_t SYSCheckAddress(struct LSInsn *li, uint64_t *ctx, uint32_t opcode, uint64_t far)
 {
-    int handled = 0;
-    int size = 0;
-    uint64_t value = 0;
-    uint32_t opcode = LE32(*(uint32_t *)elr);
-    (void)vector;
-    (void)spsr;
+    uint64_t addr = SYSEffectiveAddress(li, ctx, far);
 
-    if (esr & (1 << 24))
-    {
-        kprintf("PageFault with valid instruction syndrome: %08x\n", esr);
-    }
-
-    size = getOPsize(opcode);
-
-    D(kprintf("[JIT:SYS] Fage fault: opcode %08x, %s %p size %d\n", opcode, "write to", far, size));
-
-    /**** MISC ****/
-    if ((opcode & 0xffffffe0) == 0xd50b7e20)
-    {
-        /* Cache flushes on PiStorm-mapped region, ignore */
-        handled = 1;
-    }
-    /**** Floating point stores ****/
-    /* STUR */
-    if ((opcode & 0xbfe00c00) == 0xbc000000)
+    if (addr != far)
     {
-        if (size == 8)
-        {
-            value = get_fpn_as_double(opcode & 31);
-        }
+        /* Pairs may fault on either half, FP accesses are reported only on demand */
+        if (li->li_Form == LS_PAIR || (li->li_Flags & LSF_FP))
+            DWARN(kprintf("[JIT:SYS] Address mismatch in opcode %08x, FAR = %08x, computed %08x\n", opcode, far, addr));
         else
-        {
-            value = get_fpn_as_single(opcode & 31);
-        }
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        ptr += ((int16_t)(opcode >> 5)) >> 7;
+            kprintf("[JIT:SYS] Address mismatch in opcode %08x, FAR = %08x, computed %08x\n", opcode, far, addr);
+    }
 
-        if (ptr != far)
-        {
-            DWARN(kprintf("address mismatch in STUR %c%d. FAR = %08x, reg = %08x!\n", size == 4 ? 'S' : 'D', opcode & 31, far, ptr));
-            far = ptr;
-        }
+    return addr;
+}
 
-        handled = SYSWriteValToAddr(value, 0, size, far);
-    }
-    /* STS/STD post- and pre-index*/
-    else if ((opcode & 0xbfe00400) == 0xbc000400)
-    {
-        int pre_index = opcode & 0x800;
-        if (size == 8)
-        {
-            value = get_fpn_as_double(opcode & 31);
-        }
-        else
-        {
-            value = get_fpn_as_single(opcode & 31);
-        }
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        int16_t offset = ((int16_t)(opcode >> 5)) >> 7;
+static inline uint64_t ls_reg(uint64_t *ctx, uint8_t reg)
+{
+    return reg == 31 ? 0 : ctx[reg];
+}
 
-        // Pre-index?
-        if (pre_index) ptr += offset;
-        
-        if (ptr != far)
-        {
-            DWARN(kprintf("address mismatch in STR %c%d %s-index. FAR = %08x, reg = %08x!\n", size == 4 ? 'S' : 'D', opcode & 31, pre_index ? "pre":"post",far, ptr));
-            far = ptr;
-        }
+/*
+    Syndrome can be used if it is valid and FAR gives the start of the access. A misaligned access
+    which begins in a mapped page and ends in an unmapped one reports the first faulting byte in FAR,
+    such accesses have to be decoded and their address computed from the registers.
+*/
+static inline int SYSSyndromeUsable(uint64_t esr, uint64_t far)
+{
+    uint32_t size = 1 << ((esr >> 22) & 3);
 
-        handled = SYSWriteValToAddr(value, 0, size, far);
-        ctx[(opcode >> 5) & 31] += offset;
-    }
-    /* STS/STD unsigned offset */
-    else if ((opcode & 0xbfc00000) == 0xbd000000)
-    {
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
+    return (esr & (1 << 24)) && (far & 0xfff) >= size - 1;
+}
 
-        if (size == 8)
-        {
-            value = get_fpn_as_double(opcode & 31);
-        }
-        else
-        {
-            value = get_fpn_as_single(opcode & 31);
-        }
+/*
+    Fast path for accesses with valid instruction syndrome. These are loads and stores of a single
+    general purpose register without writeback, and the syndrome gives the size, sign extension and
+    the register, so the instruction does not need to be fetched and decoded at all.
+*/
+static int SYSPageFaultSyndrome(uint64_t *ctx, uint64_t elr, uint64_t esr, uint64_t far)
+{
+    struct LSInsn li;
+    uint64_t value = 0;
+    int handled;
 
-        ptr += ((opcode >> 10) & 0xfff) * size;
+    li.li_Size = 1 << ((esr >> 22) & 3);
+    li.li_Flags = 0;
+    li.li_Rt = (esr >> 16) & 31;
 
-        if (far != ptr)
-        {
-            DWARN(kprintf("address mismatch in STR %c%d unsigned offset FAR = %08x, reg = %08x!\n", size == 4 ? 'S' : 'D', opcode & 31, far, ptr));
-            far = ptr;
-        }
+    if (esr & (1 << 21))
+        li.li_Flags |= (esr & (1 << 15)) ? LSF_SEXT64 : LSF_SEXT32;
 
-        handled = SYSWriteValToAddr(value, 0, size, far);
+    if (esr & (1 << 6))
+    {
+        handled = SYSWriteValToAddr(ls_reg(ctx, li.li_Rt), 0, li.li_Size, far);
     }
-    /* STS/STD reg */
-    else if ((opcode & 0xbfe04c00) == 0xbc204800)
+    else
     {
-        int option = (opcode >> 13) & 7;
-        int s = (opcode & 0x1000);
-
-        if (size == 8)
-        {
-            value = get_fpn_as_double(opcode & 31);
-        }
-        else
-        {
-            value = get_fpn_as_single(opcode & 31);
-        }
-
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        uint64_t rm = ctx[(opcode >> 16) & 31];
-
-        switch (option)
-        {
-            case 0b010: // UXTW
-                rm &= 0xffffffffULL;
-                break;
-            case 0b110: // SXTW
-                if (rm & 0x80000000)
-                    rm |= 0xffffffff00000000ULL;
-                else
-                    rm &= 0x00000000ffffffffULL;
-                break;
-        }
-
-        if (s)
-        {
-            if (size == 4)
-                rm <<= 2;
-            else
-                rm <<= 3;
-        }
-
-        if (far != ptr + rm)
-        {
-            DWARN(kprintf("address mismatch in STR %c%d reg FAR = %08x, reg = %08x!\n", size == 4 ? 'S' : 'D', opcode & 31, far, ptr));
-            far = ptr + rm;
-        }        
-
-        handled = SYSWriteValToAddr(value, 0, size, far);
+        handled = SYSReadValFromAddr(&value, NULL, li.li_Size, far);
+        if (handled && li.li_Rt != 31)
+            ctx[li.li_Rt] = SYSExtendValue(&li, value);
     }
-    /**** Integer stores ****/
-    /* STUR */
-    else if ((opcode & 0x3fe00c00) == 0x38000000)
-    {   
-        if ((opcode & 31) == 31)
-            value = 0;
-        else
-            value = ctx[opcode & 31];
 
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        ptr += ((int16_t)(opcode >> 5)) >> 7;
-
-        if (ptr != far)
-        {
-            kprintf("address mismatch in STUR %c%d. FAR = %08x, reg = %08x!\n", size == 4 ? 'W' : 'X', opcode & 31, far, ptr);
-            far = ptr;
-        }
-
-        handled = SYSWriteValToAddr(value, 0, size, far);
-    }
-    /* STR immediate post-/pre-index */
-    else if ((opcode & 0x3fe00400) == 0x38000400)
+    if (!handled)
     {
-        int pre_index = opcode & 0x800;
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        int16_t offset = ((int16_t)(opcode >> 5)) >> 7;
-
-        // Pre-index?
-        if (pre_index) 
-        {
-            ptr += offset;
-        }
-
-        if ((opcode & 31) == 31)
-            value = 0;
-        else
-            value = ctx[opcode & 31];
-        
-        if (ptr != far)
-        {
-            kprintf("address mismatch in STR %c%d %s-index. FAR = %08x, reg = %08x!\n", size == 4 ? 'W' : 'X', opcode & 31, pre_index ? "pre":"post",far, ptr);
-            far = ptr;
-        }
-
-        handled = SYSWriteValToAddr(value, 0, size, far);
-        
-        ctx[(opcode >> 5) & 31] += offset;
+        kprintf("[JIT:SYS] Unhandled page fault: syndrome %08x, %s %p\n", esr, (esr & (1 << 6)) ? "write to" : "read from", far);
     }
-    /* STR unsigned offset */
-    else if ((opcode & 0x3fc00000) == 0x39000000)
-    {
-        if ((opcode & 31) == 31)
-            value = 0;
-        else
-            value = ctx[opcode & 31];
-
-        uint16_t offset = ((opcode >> 10) & 0xfff) * size;
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        if (ptr + offset != far)
-        {
-            kprintf("address mismatch in STR unsigned offset far = %08x, reg = %08x, off = %d!\n", far, ptr, offset);
-            far = ptr + offset;
-        }
 
-        handled = SYSWriteValToAddr(value, 0, size, far);
-    }
-    /* STR register */
-    else if ((opcode & 0x3fe00c00) == 0x38200800)
-    {
-        if ((opcode & 31) == 31)
-            value = 0;
-        else
-            value = ctx[opcode & 31];
+    elr += 4;
+    asm volatile("msr ELR_EL1, %0"::"r"(elr));
 
-        int option = (opcode >> 13) & 7;
-        int s = (opcode & 0x1000);
+    return handled;
+}
 
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        uint64_t rm = ctx[(opcode >> 16) & 31];
+int SYSPageFaultWriteHandler(uint32_t vector, uint64_t *ctx, uint64_t elr, uint64_t spsr, uint64_t esr, uint64_t far)
+{
+    int handled = 0;
+    uint64_t value = 0;
+    uint32_t opcode;
+    struct LSInsn li;
+    (void)vector;
+    (void)spsr;
 
-        switch (option)
-        {
-            case 0b010: // UXTW
-                rm &= 0xffffffffULL;
-                break;
-            case 0b110: // SXTW
-                if (rm & 0x80000000)
-                    rm |= 0xffffffff00000000ULL;
-                else
-                    rm &= 0x00000000ffffffffULL;
-                break;
-        }
+    if (SYSSyndromeUsable(esr, far))
+        return SYSPageFaultSyndrome(ctx, elr, esr, far);
 
-        if (s)
-        {
-            switch(size)
-            {
-                case 2:
-                    rm <<= 1;
-                    break;
-                case 4:
-                    rm <<= 2;
-                    break;
-                case 8:
-                    rm <<= 3;
-                    break;
-            }
-        }
+    opcode = LE32(*(uint32_t *)elr);
 
-        if (far != ptr + rm)
-        {
-            kprintf("address mismatch in STR %c%d reg FAR = %08x, reg = %08x!\n", size == 4 ? 'W' : 'X', opcode & 31, far, ptr);
-            far = ptr + rm;
-        }  
+    D(kprintf("[JIT:SYS] Fage fault: opcode %08x, %s %p\n", opcode, "write to", far));
 
-        handled = SYSWriteValToAddr(value, 0, size, far);
-    }
-    /* ST(L)XR register - no exclusive in this case!!! But m68k bus does not support it anyway */
-    else if ((opcode & 0x3fe07c00) == 0x08007c00)
+    if ((opcode & 0xffffffe0) == 0xd50b7e20)
     {
-        if ((opcode & 31) == 31)
-            value = 0;
-        else
-            value = ctx[opcode & 31];
-
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-
-        if (ptr != far)
-        {
-            kprintf("address mismatch in STR(L)XR FAR = %08x, reg = %08x!\n", far, ptr);
-            far = ptr;
-        }
-
-        // Mark the store as successful
-        ctx[(opcode >> 16) & 31] = 0;
-
-        handled = SYSWriteValToAddr(value, 0, size, far);
+        /* Cache flushes on PiStorm-mapped region, ignore */
+        handled = 1;
     }
-    /* STP */
-    else if ((opcode & 0x7fc00000) == 0x29000000)
+    else if (SYSDecodeLoadStore(opcode, &li) && li.li_Form == LS_PREFETCH)
     {
-        if (opcode & 0x80000000)
-            size = 8;
-        else
-            size = 4;
-
-        int16_t offset = size * (((int16_t)(opcode >> 6)) >> 9);
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        if (ptr + offset != far)
-        {
-            kprintf("address mismatch in STP offset far = %08x, reg = %08x, off = %d!\n", far, ptr, offset);
-            // STP may fail on either register access, hence, update FAR accordingly now
-            far = ptr + offset;
-        }
-
-        if (size == 4)
-        {
-            if ((opcode & 31) == 31)
-                value = 0;
-            else
-                value = ctx[opcode & 31];
-
-            value <<= 32;
-
-            if (((opcode >> 10) & 31) != 31)
-                value |= (ctx[(opcode >> 10) & 31]) & 0xFFFFFFFFULL;
-
-            handled = SYSWriteValToAddr(value, 0, 8, far);
-        }
-        else
-        {
-            uint128_t v;
-            
-            if ((opcode & 31) == 31)
-                v.hi = 0;
-            else
-                v.hi = ctx[opcode & 31];
-
-            if (((opcode >> 10) & 31) == 31)
-                v.lo = 0;
-            else
-                v.lo = ctx[(opcode >> 10) & 31];
-
-            handled = SYSWriteValToAddr(v.hi, v.lo, 16, far);
-        }
+        handled = 1;
     }
-    /* STP post index */
-    else if ((opcode & 0x7fc00000) == 0x28800000)
+    else if (li.li_Form != LS_INVALID && !(li.li_Flags & LSF_LOAD))
     {
-        int16_t offset = ((int16_t)(opcode >> 6)) >> 9;
-        if (opcode & 0x80000000)
-            size = 8;
-        else
-            size = 4;
+        far = SYSCheckAddress(&li, ctx, opcode, far);
 
-        offset *= size;
-    
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        if (ptr != far)
+        if (li.li_Form == LS_PAIR && li.li_Size == 4)
         {
-            kprintf("address mismatch in STP post index far = %08x, reg = %08x, off = %d!\n", far, ptr, offset);
-            far = ptr;
-        }
-        
-
-        if (size == 4)
-        {
-            if ((opcode & 31) == 31)
-                value = 0;
-            else
-                value = ctx[opcode & 31];
-
-            value <<= 32;
-
-            if (((opcode >> 10) & 31) != 31)
-                value |= (ctx[(opcode >> 10) & 31]) & 0xFFFFFFFFULL;
-
+            value = (ls_reg(ctx, li.li_Rt) << 32) | (ls_reg(ctx, li.li_Rt2) & 0xffffffffULL);
             handled = SYSWriteValToAddr(value, 0, 8, far);
         }
-        else
+        else if (li.li_Form == LS_PAIR)
         {
-            uint128_t v;
-            
-            if ((opcode & 31) == 31)
-                v.hi = 0;
-            else
-                v.hi = ctx[opcode & 31];
-
-            if (((opcode >> 10) & 31) == 31)
-                v.lo = 0;
-            else
-                v.lo = ctx[(opcode >> 10) & 31];
-
-            handled = SYSWriteValToAddr(v.hi, v.lo, 16, far);
+            handled = SYSWriteValToAddr(ls_reg(ctx, li.li_Rt), ls_reg(ctx, li.li_Rt2), 16, far);
         }
-
-        ctx[(opcode >> 5) & 31] += offset;
-    }
-    /* STP pre index */
-    else if ((opcode & 0x7fc00000) == 0x29800000)
-    {
-        int16_t offset = ((int16_t)(opcode >> 6)) >> 9;
-        if (opcode & 0x80000000)
-            size = 8;
         else
-            size = 4;
-
-        offset *= size;
-        
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        if (ptr + offset != far)
-        {
-            kprintf("address mismatch in STP pre index far = %08x, reg = %08x, off = %d!\n", far, ptr, offset);
-            far = ptr + offset;
-        } 
-        
-        if (size == 4)
         {
-            if ((opcode & 31) == 31)
-                value = 0;
+            if (li.li_Flags & LSF_FP)
+                value = (li.li_Size == 8) ? get_fpn_as_double(li.li_Rt) : get_fpn_as_single(li.li_Rt);
             else
-                value = ctx[opcode & 31];
-
-            value <<= 32;
+                value = ls_reg(ctx, li.li_Rt);
 
-            if (((opcode >> 10) & 31) != 31)
-                value |= (ctx[(opcode >> 10) & 31]) & 0xFFFFFFFFULL;
-
-            handled = SYSWriteValToAddr(value, 0, 8, far);
+            handled = SYSWriteValToAddr(value, 0, li.li_Size, far);
         }
-        else
-        {
-            uint128_t v;
-            
-            if ((opcode & 31) == 31)
-                v.hi = 0;
-            else
-                v.hi = ctx[opcode & 31];
-
-            if (((opcode >> 10) & 31) == 31)
-                v.lo = 0;
-            else
-                v.lo = ctx[(opcode >> 10) & 31];
 
-            handled = SYSWriteValToAddr(v.hi, v.lo, 16, far);
-        }
+        // Mark the store as successful, there is no exclusive monitor on m68k bus
+        if (handled && li.li_Flags & LSF_STATUS && li.li_Rm != 31)
+            ctx[li.li_Rm] = 0;
 
-        ctx[(opcode >> 5) & 31] += offset;
+        if (handled && li.li_Writeback != LS_WB_NONE)
+            ctx[li.li_Rn] += (int64_t)li.li_Offset;
     }
 
     if (!handled)
@@ -1513,636 +1286,72 @@ int SYSPageFaultWriteHandler(uint32_t vector, uint64_t *ctx, uint64_t elr, uint6
 int SYSPageFaultReadHandler(uint32_t vector, uint64_t *ctx, uint64_t elr, uint64_t spsr, uint64_t esr, uint64_t far)
 {
     int handled = 0;
-    int size = 0;
     uint64_t value = 0;
-    uint32_t opcode = LE32(*(uint32_t *)elr);
+    uint32_t opcode;
+    struct LSInsn li;
     (void)vector;
     (void)spsr;
 
-    if (esr & (1 << 24))
-    {
-        kprintf("PageFault with valid instruction syndrome: %08x\n", esr);
-    }
-
-    size = getOPsize(opcode);
-
-    D(kprintf("[JIT:SYS] Fage fault: opcode %08x, %s %p size %d\n", opcode, "read from", far, size));
-
-    /**** Floating point loads ****/
-    /* FLDS */
-    if ((opcode & 0xfee00c00) == 0xbc400000)
-    {
-        handled = SYSReadValFromAddr(&value, NULL, 4, far);
-        if (handled)
-        {
-            set_fpn_as_single(opcode & 31, value);
-        }
-    }
-    /* FLDS unsigned offset */
-    else if ((opcode & 0xff400000) == 0xbd400000)
-    {
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        ptr += ((opcode >> 10) & 0xfff) * 4;
-
-        if (far != ptr)
-        {
-            kprintf("address mismatch in FLDS unsigned offset far = %08x, reg = %08x!\n", far, ptr);
-            far = ptr;
-        }
-
-        handled = SYSReadValFromAddr(&value, NULL, 4, far);
-        if (handled)
-        {
-            set_fpn_as_single(opcode & 31, value);
-        }
-    }
-    /* FLDS pre-index */
-    else if ((opcode & 0xfee00c00) == 0xbc400400)
-    {
-        int16_t offset = ((int16_t)(opcode >> 5)) >> 7;
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-
-        if (far != ptr + offset)
-        {
-            kprintf("address mismatch in FLDS pre-index far = %08x, reg = %08x!\n", far, ptr + offset);
-            far = ptr + offset;
-        }
-
-        handled = SYSReadValFromAddr(&value, NULL, 4, far);
-        if (handled)
-        {
-            set_fpn_as_single(opcode & 31, value);
-            ctx[(opcode >> 5) & 31] += offset;
-        }
-    }
-    /* FLDS post-index */
-    else if ((opcode & 0xfee00c00) == 0xbc400c00)
-    {
-        int16_t offset = ((int16_t)(opcode >> 5)) >> 7;
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-
-        if (far != ptr)
-        {
-            kprintf("address mismatch in FLDS post-index far = %08x, reg = %08x!\n", far, ptr);
-            far = ptr;
-        }
+    if (SYSSyndromeUsable(esr, far))
+        return SYSPageFaultSyndrome(ctx, elr, esr, far);
 
-        handled = SYSReadValFromAddr(&value, NULL, 4, far);
-        if (handled)
-        {
-            set_fpn_as_single(opcode & 31, value);
-            ctx[(opcode >> 5) & 31] += offset;
-        }
-    }
-    /* FLDD */
-    else if ((opcode & 0xfee00c00) == 0xfc400000)
-    {
-        handled = SYSReadValFromAddr(&value, NULL, 8, far);
-        if (handled)
-        {
-            set_fpn_as_double(opcode & 31, value);
-        }
-    }
-    /* FLDD unsigned offset */
-    else if ((opcode & 0xff400000) == 0xfd400000)
-    {
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        ptr += ((opcode >> 10) & 0xfff) * 8;
+    opcode = LE32(*(uint32_t *)elr);
 
-        if (far != ptr)
-        {
-            kprintf("address mismatch in FLDD unsigned offset far = %08x, reg = %08x!\n", far, ptr);
-            far = ptr;
-        }
+    D(kprintf("[JIT:SYS] Fage fault: opcode %08x, %s %p\n", opcode, "read from", far));
 
-        handled = SYSReadValFromAddr(&value, NULL, 8, far);
-        if (handled)
-        {
-            set_fpn_as_double(opcode & 31, value);
-        }
-    }
-    /* FLDD reg offset */
-    else if ((opcode & 0xfee00c00) == 0xfc600800)
+    if (SYSDecodeLoadStore(opcode, &li) && li.li_Form == LS_PREFETCH)
     {
-        handled = SYSReadValFromAddr(&value, NULL, 8, far);
-        if (handled)
-        {
-            set_fpn_as_double(opcode & 31, value);
-        }
-    }
-    /* FLDD pre-index */
-    else if ((opcode & 0xfee00c00) == 0xfc400400)
-    {
-        int16_t offset = ((int16_t)(opcode >> 5)) >> 7;
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-
-        if (far != ptr + offset)
-        {
-            kprintf("address mismatch in FLDD pre-index far = %08x, reg = %08x!\n", far, ptr + offset);
-            far = ptr + offset;
-        }
-
-        handled = SYSReadValFromAddr(&value, NULL, 8, far);
-        if (handled)
-        {
-            set_fpn_as_double(opcode & 31, value);
-            ctx[(opcode >> 5) & 31] += offset;
-        }
-    }
-    /* FLDD post-index */
-    else if ((opcode & 0xfee00c00) == 0xbc400c00)
-    {
-        int16_t offset = ((int16_t)(opcode >> 5)) >> 7;
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-
-        if (far != ptr)
-        {
-            kprintf("address mismatch in FLDD post-index far = %08x, reg = %08x!\n", far, ptr);
-            far = ptr;
-        }
-
-        handled = SYSReadValFromAddr(&value, NULL, 8, far);
-        if (handled)
-        {
-            set_fpn_as_double(opcode & 31, value);
-            ctx[(opcode >> 5) & 31] += offset;
-        }
-    }
-    /**** Integer loads ****/
-    /* LDP */
-    else if ((opcode & 0x7fc00000) == 0x29400000)
-    {
-        if (opcode & 0x80000000)
-            size = 8;
-        else
-            size = 4;
-
-        int16_t offset = size * (((int16_t)(opcode >> 6)) >> 9);
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        if (ptr + offset != far) {
-            DWARN(kprintf("address mismatch in LDP offset far = %08x, reg = %08x, off = %d, opcode=%08x, esr=%08x!\n", far, ptr, offset, opcode, esr));
-
-            // In case of LDP/STP it is possible that fetches are out of order, so the exception can trigger on second register or on first register
-            far = ptr + offset;
-        }
-
-        if (size == 4)
-        {
-            uint64_t tmp;
-            handled = SYSReadValFromAddr(&tmp, NULL, 8, far);
-            ctx[opcode & 31] = tmp >> 32;
-            ctx[(opcode >> 10) & 31] = tmp & 0xffffffffULL;
-        }
-        else
-        {
-            handled = SYSReadValFromAddr(&ctx[opcode & 31], &ctx[(opcode >> 10) & 31], 16, far);
-        }
+        handled = 1;
     }
-    /* LDP post- and pre-index */
-    else if ((opcode & 0x7ec00000) == 0x28c00000)
+    else if (li.li_Form != LS_INVALID && (li.li_Flags & LSF_LOAD))
     {
-        int16_t offset = ((int16_t)(opcode >> 6)) >> 9;
-        if (opcode & 0x80000000)
-            size = 8;
-        else
-            size = 4;
-
-        offset *= size;
+        far = SYSCheckAddress(&li, ctx, opcode, far);
 
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-
-        if (opcode & 0x01000000) {
-            if (ptr + offset != far)
-            {
-                DWARN(kprintf("address mismatch in LDP pre index far = %08x, reg = %08x, off = %d, opcode=%08x, esr=%08x!\n", far, ptr, offset, opcode, esr));
-                far = ptr + offset;
-            }
-        }
-        else
+        if (li.li_Form == LS_PAIR && li.li_Size == 4)
         {
-            if (ptr != far)
+            handled = SYSReadValFromAddr(&value, NULL, 8, far);
+            if (handled)
             {
-                DWARN(kprintf("address mismatch in LDP post index far = %08x, reg = %08x, off = %d, opcode=%08x, esr=%08x!\n", far, ptr, offset, opcode, esr));
-                far = ptr;
+                if (li.li_Rt != 31)
+                    ctx[li.li_Rt] = SYSExtendValue(&li, value >> 32);
+                if (li.li_Rt2 != 31)
+                    ctx[li.li_Rt2] = SYSExtendValue(&li, value & 0xffffffffULL);
             }
         }
-
-        if (size == 4)
-        {
-            uint64_t tmp;
-            handled = SYSReadValFromAddr(&tmp, NULL, 8, far);
-            ctx[opcode & 31] = tmp >> 32;
-            ctx[(opcode >> 10) & 31] = tmp & 0xffffffffULL;
-        }
-        else
-        {
-            handled = SYSReadValFromAddr(&ctx[opcode & 31], &ctx[(opcode >> 10) & 31], 16, far);
-        }
-            
-        ctx[(opcode >> 5) & 31] += offset;
-    }
-    /* LDPSW */
-    if ((opcode & 0xffc00000) == 0x69400000)
-    {
-        size = 4;
-        
-        int16_t offset = size * (((int16_t)(opcode >> 6)) >> 9);
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        if (ptr + offset != far)
-        {
-            DWARN(kprintf("address mismatch in LDPSW offset far = %08x, reg = %08x, off = %d!\n", far, ptr, offset));
-            far = ptr + offset;
-        }
-
-        uint64_t tmp;
-        handled = SYSReadValFromAddr(&tmp, NULL, 2 * size, far);
-
-        if (handled) {
-            ctx[opcode & 31] = tmp >> 32;
-            if (ctx[opcode & 31] & 0x80000000)
-                ctx[opcode & 31] |= 0xffffffff00000000ULL;
-
-            ctx[(opcode >> 10) & 31] = tmp & 0xffffffffULL;
-            if (ctx[(opcode >> 10) & 31] & 0x80000000)
-                ctx[(opcode >> 10) & 31] |= 0xffffffff00000000ULL;
-        }
-    }
-    /* LDPSW post index */
-    else if ((opcode & 0xffc00000) == 0x68c00000)
-    {
-        int16_t offset = ((int16_t)(opcode >> 6)) >> 9;
-        size = 4;
-        offset *= size;
-        
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        if (ptr != far)
+        else if (li.li_Form == LS_PAIR)
         {
-            DWARN(kprintf("address mismatch in LDPSW post index far = %08x, reg = %08x, off = %d!\n", far, ptr, offset));
-            far = ptr;
-        }
-
-        uint64_t tmp;
-        handled = SYSReadValFromAddr(&tmp, NULL, 2 * size, far);
+            uint64_t value2 = 0;
 
-        if (handled) {
-            ctx[opcode & 31] = tmp >> 32;
-            if (ctx[opcode & 31] & 0x80000000)
-                ctx[opcode & 31] |= 0xffffffff00000000ULL;
-
-            ctx[(opcode >> 10) & 31] = tmp & 0xffffffffULL;
-            if (ctx[(opcode >> 10) & 31] & 0x80000000)
-                ctx[(opcode >> 10) & 31] |= 0xffffffff00000000ULL;
-        }
-
-        ctx[(opcode >> 5) & 31] += offset;
-    }
-    /* LDPSW pre index */
-    else if ((opcode & 0xffc00000) == 0x69c00000)
-    {
-        int16_t offset = ((int16_t)(opcode >> 6)) >> 9;
-        size = 4;
-        offset *= size;
-
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        if (ptr + offset != far)
-        {
-            DWARN(kprintf("address mismatch in LDPSW pre index far = %08x, reg = %08x, off = %d!\n", far, ptr, offset));
-            far = ptr + offset;
-        }
-
-        uint64_t tmp;
-        handled = SYSReadValFromAddr(&tmp, NULL, 2 * size, far);
-
-        if (handled) {
-            ctx[opcode & 31] = tmp >> 32;
-            if (ctx[opcode & 31] & 0x80000000)
-                ctx[opcode & 31] |= 0xffffffff00000000ULL;
-
-            ctx[(opcode >> 10) & 31] = tmp & 0xffffffffULL;
-            if (ctx[(opcode >> 10) & 31] & 0x80000000)
-                ctx[(opcode >> 10) & 31] |= 0xffffffff00000000ULL;
-        }
-
-        ctx[(opcode >> 5) & 31] += offset;
-    }
-    /* LDR (literal) */
-    else if ((opcode & 0xbf000000) == 0x18000000 || (opcode & 0xff000000) == 0x98000000)
-    {
-        int sext = 0;
-        if (opcode & 0x40000000)
-            size = 8;
-        else
-            size = 4;
-        if (opcode & 0x80000000)
-            sext = 1;
-        
-        handled = SYSReadValFromAddr(&ctx[opcode & 31], NULL, size, far);
-        if (handled & sext) {
-            if (ctx[opcode & 31] & 0x80000000)
-                ctx[opcode & 31] |= 0xffffffff00000000ULL;
-        }
-    }
-    /* LDR register */
-    else if ((opcode & 0x3fe00c00) == 0x38600800)
-    {
-        int option = (opcode >> 13) & 7;
-        int s = (opcode & 0x1000);
-
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        uint64_t rm = ctx[(opcode >> 16) & 31];
-
-        switch (option)
-        {
-            case 0b010: // UXTW
-                rm &= 0xffffffffULL;
-                break;
-            case 0b110: // SXTW
-                if (rm & 0x80000000)
-                    rm |= 0xffffffff00000000ULL;
-                else
-                    rm &= 0x00000000ffffffffULL;
-                break;
-        }
-
-        if (s)
-        {
-            switch(size)
+            handled = SYSReadValFromAddr(&value, &value2, 16, far);
+            if (handled)
             {
-                case 2:
-                    rm <<= 1;
-                    break;
-                case 4:
-                    rm <<= 2;
-                    break;
-                case 8:
-                    rm <<= 3;
-                    break;
-            }
-        }
-
-        if (far != ptr + rm)
-        {
-            kprintf("address mismatch in LDR %c%d reg FAR = %08x, reg = %08x!\n", size == 4 ? 'W' : 'X', opcode & 31, far, ptr);
-            far = ptr + rm;
-        }  
-
-        handled = SYSReadValFromAddr(&ctx[opcode & 31], NULL, size, far);
-    }
-    /* LDXR register - no exclusive in this case!!! But m68k bus does not support it anyway */
-    else if ((opcode & 0x3ffffc00) == 0x085f7c00)
-    {
-        handled = SYSReadValFromAddr(&ctx[opcode & 31], NULL, size, far);
-    }
-    /* LDR immediate */
-    else if ((opcode & 0x3fc00000) == 0x39400000)
-    {
-        uint64_t offset = (opcode >> 10) & 0xfff;
-        offset *= size;
-
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        if (ptr + offset != far)
-        {
-            kprintf("address mismatch in LDR imm far = %08x, reg = %08x, off = %d!\n", far, ptr, offset);
-            far = ptr + offset;
-        }
-
-        handled = SYSReadValFromAddr(&ctx[opcode & 31], NULL, size, far);
-    }
-    /* LDUR(B/W) */
-    else if ((opcode & 0x3fe00c00) == 0x38400000)
-    {
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        ptr += ((int16_t)(opcode >> 5)) >> 7;
-
-        if (ptr != far)
-        {
-            kprintf("address mismatch in LDUR %c%d. FAR = %08x, reg = %08x!\n", size == 4 ? 'W' : 'X', opcode & 31, far, ptr);
-            far = ptr;
-        }
-
-        handled = SYSReadValFromAddr(&ctx[opcode & 31], NULL, size, far);
-    }
-    /* LDR immediate, post- and pre-index */
-    else if ((opcode & 0x3fe00400) == 0x38400400)
-    {
-        int64_t offset = ((int16_t)(opcode >> 5)) >> 7;
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        if (opcode & (1 << 11 ))
-        {
-            if (ptr + offset != far)
-            {
-                kprintf("address mismatch in LDR pre-index far = %08x, reg = %08x, off = %d!\n", far, ptr, offset);
-                far = ptr + offset;
+                if (li.li_Rt != 31)
+                    ctx[li.li_Rt] = value;
+                if (li.li_Rt2 != 31)
+                    ctx[li.li_Rt2] = value2;
             }
         }
         else
         {
-            if (ptr != far)
+            handled = SYSReadValFromAddr(&value, NULL, li.li_Size, far);
+            if (handled)
             {
-                kprintf("address mismatch in LDR post-index far = %08x, reg = %08x, off = %d!\n", far, ptr, offset);
-                far = ptr;
+                if (li.li_Flags & LSF_FP)
+                {
+                    if (li.li_Size == 8)
+                        set_fpn_as_double(li.li_Rt, value);
+                    else
+                        set_fpn_as_single(li.li_Rt, value);
+                }
+                else if (li.li_Rt != 31)
+                {
+                    ctx[li.li_Rt] = SYSExtendValue(&li, value);
+                }
             }
         }
 
-        handled = SYSReadValFromAddr(&ctx[opcode & 31], NULL, size, far);
-        
-        if (handled)
-            ctx[(opcode >> 5) & 31] += offset;
-    }
-    /* LDRSW/LDRSB/LDRSH register */
-    else if ((opcode & 0x3fa00c00) == 0x38a00800)
-    {
-        int sext64 = 1;
-        if (opcode & (1 << 22))
-            sext64 = 0;
-        
-        int option = (opcode >> 13) & 7;
-        int s = (opcode & 0x1000);
-
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        uint64_t rm = ctx[(opcode >> 16) & 31];
-
-        switch (option)
-        {
-            case 0b010: // UXTW
-                rm &= 0xffffffffULL;
-                break;
-            case 0b110: // SXTW
-                if (rm & 0x80000000)
-                    rm |= 0xffffffff00000000ULL;
-                else
-                    rm &= 0x00000000ffffffffULL;
-                break;
-        }
-
-        if (s)
-        {
-            switch(size)
-            {
-                case 2:
-                    rm <<= 1;
-                    break;
-                case 4:
-                    rm <<= 2;
-                    break;
-                case 8:
-                    rm <<= 3;
-                    break;
-            }
-        }
-
-        if (far != ptr + rm)
-        {
-            kprintf("address mismatch in LDRSW/B/H %c%d reg FAR = %08x, reg = %08x!\n", size == 4 ? 'W' : 'X', opcode & 31, far, ptr);
-            far = ptr + rm;
-        }  
-
-        handled = SYSReadValFromAddr(&ctx[opcode & 31], NULL, size, far);
-        if (handled) {
-            int sext = 0;
-            switch (size)
-            {
-                case 1:
-                    sext = ctx[opcode & 31] & 0x80;
-                    if (sext) ctx[opcode & 31] |= 0xffffff00;
-                    break;
-                case 2:
-                    sext = ctx[opcode & 31] & 0x8000;
-                    if (sext) ctx[opcode & 31] |= 0xffff0000;
-                    break;
-                case 4:
-                    sext = ctx[opcode & 31] & 0x80000000;
-                    break;
-            }
-
-            if (sext && sext64) {
-                ctx[opcode & 31] |= 0xffffffff00000000ULL;
-            }
-        }
-    }
-    /* LDRSW/LDRSB/LDRSH immediate */
-    else if ((opcode & 0x3f800000) == 0x39800000)
-    {
-        int sext64 = 1;
-        if (opcode & (1 << 22))
-            sext64 = 0;
-        
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        ptr += ((opcode >> 10) & 0xfff) * size;
-
-        if (ptr != far)
-        {
-            kprintf("address mismatch in LDRSW/B/H imm. FAR = %08x, reg = %08x!\n", far, ptr);
-            far = ptr;
-        }
-
-        handled = SYSReadValFromAddr(&ctx[opcode & 31], NULL, size, far);
-        if (handled) {
-            int sext = 0;
-            switch (size)
-            {
-                case 1:
-                    sext = ctx[opcode & 31] & 0x80;
-                    if (sext) ctx[opcode & 31] |= 0xffffff00;
-                    break;
-                case 2:
-                    sext = ctx[opcode & 31] & 0x8000;
-                    if (sext) ctx[opcode & 31] |= 0xffff0000;
-                    break;
-                case 4:
-                    sext = ctx[opcode & 31] & 0x80000000;
-                    break;
-            }
-
-            if (sext && sext64) {
-                ctx[opcode & 31] |= 0xffffffff00000000ULL;
-            }
-        }
-    }
-    /* LDURSW/LDURSB/LDURSH immediate */
-    else if ((opcode & 0x3fa00c00) == 0x38800000)
-    {
-        int sext64 = 1;
-        if (opcode & (1 << 22))
-            sext64 = 0;
-
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-        ptr += ((int16_t)(opcode >> 5)) >> 7;
-
-        if (ptr != far)
-        {
-            kprintf("address mismatch in LDURS %c%d. FAR = %08x, reg = %08x!\n", size == 4 ? 'W' : 'X', opcode & 31, far, ptr);
-            far = ptr;
-        }
-        
-        handled = SYSReadValFromAddr(&ctx[opcode & 31], NULL, size, far);
-        if (handled) {
-            int sext = 0;
-            switch (size)
-            {
-                case 1:
-                    sext = ctx[opcode & 31] & 0x80;
-                    if (sext) ctx[opcode & 31] |= 0xffffff00;
-                    break;
-                case 2:
-                    sext = ctx[opcode & 31] & 0x8000;
-                    if (sext) ctx[opcode & 31] |= 0xffff0000;
-                    break;
-                case 4:
-                    sext = ctx[opcode & 31] & 0x80000000;
-                    break;
-            }
-
-            if (sext && sext64) {
-                ctx[opcode & 31] |= 0xffffffff00000000ULL;
-            }
-        }
-    }
-    /* LDRSW/LDRSB/LDRSH post- and pre-index */
-    else if ((opcode & 0x3fa00400) == 0x38800400)
-    {
-        int16_t offset = ((int16_t)(opcode >> 5)) >> 7;
-        int sext64 = 1;
-        if (opcode & (1 << 22))
-            sext64 = 0;
-
-        uint64_t ptr = ctx[(opcode >> 5) & 31];
-
-        if (opcode & 0x800)
-        {
-            ptr += offset;
-        }
-        
-        if (far != ptr)
-        {
-            kprintf("address mismatch in LDRSW/B/H post-/pre-index. FAR = %08x, reg = %08x!\n", far, ptr);
-            far = ptr;
-        }
-
-        handled = SYSReadValFromAddr(&ctx[opcode & 31], NULL, size, far);
-        if (handled) {
-            int sext = 0;
-            switch (size)
-            {
-                case 1:
-                    sext = ctx[opcode & 31] & 0x80;
-                    if (sext) ctx[opcode & 31] |= 0xffffff00;
-                    break;
-                case 2:
-                    sext = ctx[opcode & 31] & 0x8000;
-                    if (sext) ctx[opcode & 31] |= 0xffff0000;
-                    break;
-                case 4:
-                    sext = ctx[opcode & 31] & 0x80000000;
-                    break;
-            }
-
-            if (sext && sext64) {
-                ctx[opcode & 31] |= 0xffffffff00000000ULL;
-            }
-
-            ctx[(opcode >> 5) & 31] += offset;
-        }
+        if (handled && li.li_Writeback != LS_WB_NONE)
+            ctx[li.li_Rn] += (int64_t)li.li_Offset;
     }
 
     if (!handled)
@@ -2171,7 +1380,16 @@ void SYSHandler(uint32_t vector, uint64_t *ctx)
     {
         int writeFault = (esr & (1 << 6)) != 0;
 
-        handled = writeFault ? SYSPageFaultWriteHandler(vector, ctx, elr, spsr, esr, far) : SYSPageFaultReadHandler(vector, ctx, elr, spsr, esr, far);
+        /* Permission fault on a page with translated code, store is restarted once page is writable */
+        if (writeFault && (esr & 0x3c) == 0x0c && M68K_WriteProtectFault(far))
+            handled = 1;
+        else
+        {
+            handled = writeFault ? SYSPageFaultWriteHandler(vector, ctx, elr, spsr, esr, far) : SYSPageFaultReadHandler(vector, ctx, elr, spsr, esr, far);
+
+            if (handled)
+                M68K_FaultSite(elr);
+        }
     }
     else if ((vector & 0x1ff) == 0x00 && (esr & 0xf8000000) == 0x80000000)
     {
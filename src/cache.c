@@ -36,6 +36,7 @@ struct Cache
     uint32_t            c_Tags[CACHE_SET_COUNT][CACHE_WAY_COUNT];
     uint8_t             c_Flags[CACHE_SET_COUNT][CACHE_WAY_COUNT];
     uint32_t            c_WaySelect[CACHE_SET_COUNT];
+    uint32_t            c_Empty;        /* No line was loaded since the cache was invalidated */
 };
 
 struct Cache *IC;
@@ -77,6 +78,9 @@ void cache_setup()
         }
     }
 
+    IC->c_Empty = 1;
+    DC->c_Empty = 1;
+
     (kprintf("[CACHE] ICache @ %p, DCache @ %p\n", IC, DC));
 }
 
@@ -86,6 +90,8 @@ void cache_invalidate_all(enum CacheType type)
 
     D(kprintf("[CACHE] %cCache invalidate all\n", type == ICACHE ? 'I':'D'));
 
+    cache->c_Empty = 1;
+
     for (int i=0; i < CACHE_SET_COUNT; i++)
     {
         cache->c_WaySelect[i] = 0;
@@ -129,6 +135,16 @@ void cache_flush_all(enum CacheType type)
             cache->c_Flags[set][way] = 0;
         }        
     }
+
+    cache->c_Empty = 1;
+}
+
+/* If the cache is empty, every read from it returns current contents of memory */
+int cache_is_empty(enum CacheType type)
+{
+    struct Cache *cache = (type == ICACHE) ? IC : DC;
+
+    return cache->c_Empty;
 }
 
 void cache_invalidate_line(enum CacheType type, uint32_t address)
@@ -279,6 +295,7 @@ uint128_t cache_read_128(enum CacheType type, uint32_t address)
 
         /* Update tag, mark page as valid */
         cache->c_Flags[set][way] = F_VALID;
+        cache->c_Empty = 0;
         cache->c_Tags[set][way] = tag;
     }
 
@@ -410,6 +427,7 @@ uint64_t cache_read_64(enum CacheType type, uint32_t address)
 
         /* Update tag, mark page as valid */
         cache->c_Flags[set][way] = F_VALID;
+        cache->c_Empty = 0;
         cache->c_Tags[set][way] = tag;
     }
 
@@ -519,6 +537,7 @@ uint32_t cache_read_32(enum CacheType type, uint32_t address)
 
         /* Update tag, mark page as valid */
         cache->c_Flags[set][way] = F_VALID;
+        cache->c_Empty = 0;
         cache->c_Tags[set][way] = tag;
     }
 
@@ -612,6 +631,7 @@ uint16_t cache_read_16(enum CacheType type, uint32_t address)
 
         /* Update tag, mark page as valid */
         cache->c_Flags[set][way] = F_VALID;
+        cache->c_Empty = 0;
         cache->c_Tags[set][way] = tag;
     }
 
@@ -697,6 +717,7 @@ uint8_t cache_read_8(enum CacheType type, uint32_t address)
 
         /* Update tag, mark page as valid */
         cache->c_Flags[set][way] = F_VALID;
+        cache->c_Empty = 0;
         cache->c_Tags[set][way] = tag;
     }
 
@@ -788,6 +809,7 @@ int cache_write_128(enum CacheType type, uint32_t address, uint128_t data, uint8
 
         /* Update tag, mark page as valid */
         cache->c_Flags[set][way] = F_VALID;
+        cache->c_Empty = 0;
         cache->c_Tags[set][way] = tag;
     }
 
@@ -890,6 +912,7 @@ int cache_write_64(enum CacheType type, uint32_t address, uint64_t data, uint8_t
 
         /* Update tag, mark page as valid */
         cache->c_Flags[set][way] = F_VALID;
+        cache->c_Empty = 0;
         cache->c_Tags[set][way] = tag;
     }
 
@@ -1007,6 +1030,7 @@ int cache_write_32(enum CacheType type, uint32_t address, uint32_t data, uint8_t
 
         /* Update tag, mark page as valid */
         cache->c_Flags[set][way] = F_VALID;
+        cache->c_Empty = 0;
         cache->c_Tags[set][way] = tag;
     }
 
@@ -1130,6 +1154,7 @@ int cache_write_16(enum CacheType type, uint32_t address, uint16_t data, uint8_t
 
         /* Update tag, mark page as valid */
         cache->c_Flags[set][way] = F_VALID;
+        cache->c_Empty = 0;
         cache->c_Tags[set][way] = tag;
     }
 
@@ -1246,6 +1271,7 @@ int cache_write_8(enum CacheType type, uint32_t address, uint8_t data, uint8_t w
 
         /* Update tag, mark page as valid */
         cache->c_Flags[set][way] = F_VALID;
+        cache->c_Empty = 0;
         cache->c_Tags[set][way] = tag;
     }
 
@@ -108,18 +108,74 @@ struct MD5 CalcMD5(void *_start, void *_end)
 }
 
 #include "cache.h"
+#include "tlsf.h"
 
-uint32_t CalcCRC32(void *_start, void *_end)
+/*
+    CRC32 of m68k code. The crc32x instruction has a latency of few cycles, therefore longer ranges
+    are split into three interleaved streams which are computed in parallel and merged afterwards.
+    Merging multiplies the CRC of first two streams by x^(8n) with PMULL, where n is the number of
+    bytes following them. The constants are x^(8n-33) mod P for n = 64 and n = 128.
+*/
+#define CRC32_FOLD_BLOCK    64
+#define CRC32_FOLD_K1       0x1d9513d7
+#define CRC32_FOLD_K2       0x910eeec1
+
+static int crc32_pmull = -1;
+
+static inline uint32_t crc32_fold(uint32_t crc, intptr_t s)
 {
-    intptr_t s = (intptr_t)_start;
-    intptr_t e = (intptr_t)_end;
+    uint32_t crc1 = 0;
+    uint32_t crc2 = 0;
+    uint64_t merged;
+
+    for (int i=0; i < CRC32_FOLD_BLOCK; i += 16)
+    {
+        uint64_t a1, a2, b1, b2, c1, c2;
+
+        asm volatile("ldp %0, %1, [%2]":"=r"(a1), "=r"(a2):"r"(s + i));
+        asm volatile("ldp %0, %1, [%2]":"=r"(b1), "=r"(b2):"r"(s + i + CRC32_FOLD_BLOCK));
+        asm volatile("ldp %0, %1, [%2]":"=r"(c1), "=r"(c2):"r"(s + i + 2 * CRC32_FOLD_BLOCK));
+        asm volatile("crc32x %w0, %w0, %2":"=r"(crc):"0"(crc),"r"(a1));
+        asm volatile("crc32x %w0, %w0, %2":"=r"(crc1):"0"(crc1),"r"(b1));
+        asm volatile("crc32x %w0, %w0, %2":"=r"(crc2):"0"(crc2),"r"(c1));
+        asm volatile("crc32x %w0, %w0, %2":"=r"(crc):"0"(crc),"r"(a2));
+        asm volatile("crc32x %w0, %w0, %2":"=r"(crc1):"0"(crc1),"r"(b2));
+        asm volatile("crc32x %w0, %w0, %2":"=r"(crc2):"0"(crc2),"r"(c2));
+    }
+
+    /* PMULL is given as raw opcode, the kernel is built for armv8-a+crc only */
+    asm volatile(
+"       fmov    d0, %1                  \n"
+"       fmov    d1, %2                  \n"
+"       fmov    d2, %3                  \n"
+"       fmov    d3, %4                  \n"
+"       .inst   0x0ee1e000              \n" // pmull v0.1q, v0.1d, v1.1d
+"       .inst   0x0ee3e042              \n" // pmull v2.1q, v2.1d, v3.1d
+"       eor     v0.16b, v0.16b, v2.16b  \n"
+"       fmov    %0, d0                  \n"
+    :"=r"(merged)
+    :"r"((uint64_t)crc), "r"((uint64_t)CRC32_FOLD_K2), "r"((uint64_t)crc1), "r"((uint64_t)CRC32_FOLD_K1)
+    :"v0", "v1", "v2", "v3");
+
+    asm volatile("crc32x %w0, wzr, %1":"=r"(crc):"r"(merged));
 
+    return crc ^ crc2;
+}
+
+static uint32_t crc32_range(intptr_t s, intptr_t e, int direct, int fold)
+{
     uint32_t crc = 0xffffffff;
 
     while((e - s) >= 16) {
         uint64_t val1; uint64_t val2;
-        if (s > 0x01000000)
+        if (direct || s >= 0x01000000)
         {
+            if (fold && (e - s) >= 3 * CRC32_FOLD_BLOCK)
+            {
+                crc = crc32_fold(crc, s);
+                s += 3 * CRC32_FOLD_BLOCK;
+                continue;
+            }
             asm volatile("ldp %0, %1, [%2]":"=r"(val1), "=r"(val2):"r"(s));
         }
         else
@@ -133,7 +189,7 @@ uint32_t CalcCRC32(void *_start, void *_end)
     }
     if ((e - s) >= 8) {
         uint64_t val;
-        if (s > 0x01000000)
+        if (direct || s >= 0x01000000)
             val = *(uint64_t *)s;
         else
             val = cache_read_64(ICACHE, s);
@@ -142,7 +198,7 @@ uint32_t CalcCRC32(void *_start, void *_end)
     }
     if ((e - s) >= 4) {
         uint32_t val;
-        if (s > 0x01000000)
+        if (direct || s >= 0x01000000)
             val = *(uint32_t *)s;
         else
             val = cache_read_32(ICACHE, s);
@@ -151,7 +207,7 @@ uint32_t CalcCRC32(void *_start, void *_end)
     }
     if ((e - s) >= 2) {
         uint16_t val;
-        if (s > 0x01000000)
+        if (direct || s >= 0x01000000)
             val = *(uint16_t *)s;
         else
             val = cache_read_16(ICACHE, s);
@@ -160,7 +216,7 @@ uint32_t CalcCRC32(void *_start, void *_end)
     }
     if (e != s) {
         uint16_t val;
-        if (s > 0x01000000)
+        if (direct || s >= 0x01000000)
             val = *(uint16_t *)s;
         else
             val = cache_read_8(ICACHE, s);
@@ -168,4 +224,73 @@ uint32_t CalcCRC32(void *_start, void *_end)
     }
 
     return crc;
-}
\ No newline at end of file
+}
+
+uint32_t CalcCRC32(void *_start, void *_end)
+{
+    intptr_t s = (intptr_t)_start;
+    intptr_t e = (intptr_t)_end;
+
+    if (__builtin_expect(crc32_pmull < 0, 0))
+    {
+        uint64_t isar0;
+        asm volatile("mrs %0, ID_AA64ISAR0_EL1":"=r"(isar0));
+        crc32_pmull = ((isar0 >> 4) & 15) >= 2;
+    }
+
+    /*
+        Below 16MB the code is read through the emulated instruction cache. If the cache holds no
+        line at all, it would return contents of memory anyway, so the memory is read directly.
+    */
+    return crc32_range(s, e, s >= 0x01000000 || cache_is_empty(ICACHE), crc32_pmull);
+}
+
+void CalcCRC32Benchmark()
+{
+    static const uint32_t sizes[] = { 32, 64, 128, 256, 512, 1024, 4096 };
+    const uint32_t iter_count = 10000;
+    uint8_t *buffer = tlsf_malloc(tlsf, 4096);
+    int pmull;
+
+    if (buffer == NULL)
+        return;
+
+    for (int i=0; i < 4096; i++)
+        buffer[i] = i * 7 + (i >> 8);
+
+    CalcCRC32(buffer, buffer + 4);
+    pmull = crc32_pmull;
+
+    kprintf("[CRC32] Benchmark of block checksum, PMULL %savailable\n", pmull ? "" : "not ");
+    kprintf("[CRC32]   size  scalar  folded  (cycles per call)\n");
+
+    for (unsigned i=0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        uint64_t cnt1, cnt2, scalar, folded = 0;
+        intptr_t s = (intptr_t)buffer;
+        intptr_t e = s + sizes[i];
+        uint32_t crc_scalar = 0, crc_folded = 0;
+
+        asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt1));
+        for (uint32_t j=0; j < iter_count; j++)
+            crc_scalar = crc32_range(s, e, 1, 0);
+        asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt2));
+        scalar = cnt2 - cnt1;
+
+        if (pmull)
+        {
+            asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt1));
+            for (uint32_t j=0; j < iter_count; j++)
+                crc_folded = crc32_range(s, e, 1, 1);
+            asm volatile("mrs %0, PMCCNTR_EL0":"=r"(cnt2));
+            folded = cnt2 - cnt1;
+
+            if (crc_folded != crc_scalar)
+                kprintf("[CRC32]   size %d: folded CRC %08x does not match %08x!\n", sizes[i], crc_folded, crc_scalar);
+        }
+
+        kprintf("[CRC32]   %4d  %6d  %6d\n", sizes[i], (uint32_t)(scalar / iter_count), (uint32_t)(folded / iter_count));
+    }
+
+    tlsf_free(tlsf, buffer);
+}
@@ -888,14 +888,15 @@ void ps_housekeeper()
 
 #if PISTORM_WRITE_BUFFER
 
-#define WRITEBUFFER_SIZE  PISTORM_WRITE_BUFFER_SIZE
-
 struct WriteRequest {
     uint32_t  wr_addr;
     uint32_t  wr_value;
     uint8_t   wr_size;
 };
 
+/* Depth of the buffer (power of two), can be raised with wb_depth= boot argument */
+uint32_t wb_depth = PISTORM_WRITE_BUFFER_SIZE;
+
 struct WriteRequest *wr_buffer;
 volatile uint32_t wr_head;
 volatile uint32_t wr_tail;
@@ -903,12 +904,12 @@ volatile unsigned char bus_lock = 0;
 
 void wb_push(uint32_t address, uint32_t value, uint8_t size)
 {
-    while(wr_tail + WRITEBUFFER_SIZE <= wr_head)
+    while(wr_tail + wb_depth <= wr_head)
         asm volatile("yield");
     
-    wr_buffer[wr_head & (WRITEBUFFER_SIZE - 1)].wr_addr = address;
-    wr_buffer[wr_head & (WRITEBUFFER_SIZE - 1)].wr_value = value;
-    wr_buffer[wr_head & (WRITEBUFFER_SIZE - 1)].wr_size = size;
+    wr_buffer[wr_head & (wb_depth - 1)].wr_addr = address;
+    wr_buffer[wr_head & (wb_depth - 1)].wr_value = value;
+    wr_buffer[wr_head & (wb_depth - 1)].wr_size = size;
 
     asm volatile("dmb sy":::"memory");
 
@@ -917,26 +918,13 @@ void wb_push(uint32_t address, uint32_t value, uint8_t size)
     asm volatile("sev");
 }
 
-struct WriteRequest wb_pop()
-{
-    while (wr_tail == wr_head) {
-        asm volatile("wfe");
-    }
-
-    struct WriteRequest data = wr_buffer[wr_tail & (WRITEBUFFER_SIZE - 1)];
-
-    __sync_add_and_fetch(&wr_tail, 1);
-    
-    return data;
-}
-
 struct WriteRequest wb_peek()
 {
     while (wr_tail == wr_head) {
         asm volatile("wfe");
     }
 
-    struct WriteRequest data = wr_buffer[wr_tail & (WRITEBUFFER_SIZE - 1)];
+    struct WriteRequest data = wr_buffer[wr_tail & (wb_depth - 1)];
 
     return data;
 }
@@ -958,7 +946,7 @@ void wb_waitfree()
 void wb_init()
 {
 #if PISTORM_WRITE_BUFFER
-    wr_buffer = tlsf_malloc(tlsf, sizeof(struct WriteRequest) * WRITEBUFFER_SIZE);
+    wr_buffer = tlsf_malloc(tlsf, sizeof(struct WriteRequest) * wb_depth);
     wr_head = wr_tail = 0;
     bus_lock = 0;
 #endif
@@ -986,28 +974,110 @@ static inline void check_blit_active(unsigned int addr, unsigned int size)
     }
 }
 
+#if PISTORM_WRITE_BUFFER
+/*
+    Merge writes queued after the one at the tail of the buffer, as long as they continue it without
+    a gap and stay within the same 16-byte line of chip RAM. The writes are only taken from the
+    buffer, never reordered, so the first write which cannot be merged (e.g. to a custom register)
+    ends the line. Returns the number of buffer entries covered, the merged data is put in line[]
+*/
+static uint32_t wb_coalesce(struct WriteRequest *req, uint8_t *line, uint32_t *length)
+{
+    uint32_t count = 1;
+    uint32_t end = req->wr_addr + req->wr_size;
+    uint32_t head;
+
+    for (int i=0; i < req->wr_size; i++)
+        line[i] = req->wr_value >> (8 * (req->wr_size - 1 - i));
+
+    *length = req->wr_size;
+
+    if (req->wr_addr >= 0x200000)
+        return 1;
+
+    /*
+        Take the head once, with acquire semantics. Entries below it were completely written by
+        the producer before it advanced the head, entries added later are left for the next round.
+    */
+    head = __atomic_load_n(&wr_head, __ATOMIC_ACQUIRE);
+
+    while (wr_tail + count != head)
+    {
+        struct WriteRequest *next = &wr_buffer[(wr_tail + count) & (wb_depth - 1)];
+
+        if (next->wr_addr != end || ((next->wr_addr + next->wr_size - 1) ^ req->wr_addr) & ~15)
+            break;
+
+        for (int i=0; i < next->wr_size; i++)
+            line[*length + i] = next->wr_value >> (8 * (next->wr_size - 1 - i));
+
+        *length += next->wr_size;
+        end += next->wr_size;
+        count++;
+    }
+
+    return count;
+}
+#endif
+
 void wb_task()
 {
 #if PISTORM_WRITE_BUFFER
-    kprintf("[WBACK] Write buffer activated\n");
+    kprintf("[WBACK] Write buffer of %d entries activated\n", wb_depth);
 
     while(1) {
         struct WriteRequest req = wb_peek();
+        uint8_t line[16];
+        uint32_t length;
+        uint32_t count;
+
+        asm volatile("dmb sy":::"memory");
+
+        count = wb_coalesce(&req, line, &length);
 
         while(__atomic_test_and_set(&bus_lock, __ATOMIC_ACQUIRE)) { asm volatile("yield"); }
 
-        check_blit_active(req.wr_addr, req.wr_size);
-
-        switch (req.wr_size) {
-            case 1:
-                ps_write_8_int(req.wr_addr, req.wr_value);
-                break;
-            case 2:
-                ps_write_16_int(req.wr_addr, req.wr_value);
-                break;
-            case 4:
-                ps_write_32_int(req.wr_addr, req.wr_value);
-                break;
+        check_blit_active(req.wr_addr, length);
+
+        if (count == 1)
+        {
+            switch (req.wr_size) {
+                case 1:
+                    ps_write_8_int(req.wr_addr, req.wr_value);
+                    break;
+                case 2:
+                    ps_write_16_int(req.wr_addr, req.wr_value);
+                    break;
+                case 4:
+                    ps_write_32_int(req.wr_addr, req.wr_value);
+                    break;
+            }
+        }
+        else
+        {
+            /* Write the line with widest bus cycles possible, odd bytes go through byte cycles */
+            uint32_t addr = req.wr_addr;
+            uint32_t i = 0;
+
+            if (addr & 1)
+            {
+                ps_write_8_int(addr, line[0]);
+                addr++;
+                i++;
+            }
+
+            for (; i + 4 <= length; i += 4, addr += 4)
+                ps_write_32_int(addr, (line[i] << 24) | (line[i + 1] << 16) | (line[i + 2] << 8) | line[i + 3]);
+
+            if (i + 2 <= length)
+            {
+                ps_write_16_int(addr, (line[i] << 8) | line[i + 1]);
+                i += 2;
+                addr += 2;
+            }
+
+            if (i < length)
+                ps_write_8_int(addr, line[i]);
         }
 #if CIA_DELAY
         if (req.wr_addr >= 0xbf0000 && req.wr_addr <= 0xbfffff) {
@@ -1021,7 +1091,7 @@ void wb_task()
 #endif
         __atomic_clear(&bus_lock, __ATOMIC_RELEASE);
 
-        wb_pop();
+        __sync_add_and_fetch(&wr_tail, count);
     }
 #else
     while(1) asm volatile("wfi");
@@ -0,0 +1,222 @@
+/*
+    Copyright © 2019 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include "lsdecode.h"
+
+/*
+    Host test of the load/store decoder used by data abort handlers. Opcodes were assembled with
+    llvm-mc, registers are chosen so that every field has a distinct value (Rt = 3, Rt2/Rm/Rs = 7,
+    Rn = 5). Effective addresses are computed with x5 = 0x10000 and x7 = 0xfffffffe.
+*/
+
+#define DC      0x7fffffff          /* Field not checked */
+#define DC64    0xffffffffffffffffULL
+
+#define X5      0x10000ULL
+#define X7      0xfffffffeULL
+#define FAR     0xdead0000ULL
+
+struct TestCase {
+    uint32_t    opcode;
+    const char *name;
+    int         ok;
+    int         form;
+    int         flags;
+    int         size;
+    int         writeback;
+    int         rt;
+    int         rt2;
+    int         rn;
+    int         rm;
+    int         extend;
+    int         shift;
+    int         offset;
+    uint64_t    addr;
+};
+
+#define L   LSF_LOAD
+#define S32 LSF_SEXT32
+#define S64 LSF_SEXT64
+
+static const struct TestCase tests[] = {
+    /* Integer, unsigned 12-bit offset */
+    { 0x390044a3, "strb w3, [x5, #17]",         1, LS_UIMM12, 0,        1, LS_WB_NONE, 3, DC, 5, DC, DC, DC, 17, X5 + 17 },
+    { 0x394044a3, "ldrb w3, [x5, #17]",         1, LS_UIMM12, L,        1, LS_WB_NONE, 3, DC, 5, DC, DC, DC, 17, X5 + 17 },
+    { 0x398044a3, "ldrsb x3, [x5, #17]",        1, LS_UIMM12, L|S64,    1, LS_WB_NONE, 3, DC, 5, DC, DC, DC, 17, X5 + 17 },
+    { 0x39c044a3, "ldrsb w3, [x5, #17]",        1, LS_UIMM12, L|S32,    1, LS_WB_NONE, 3, DC, 5, DC, DC, DC, 17, X5 + 17 },
+    { 0x790044a3, "strh w3, [x5, #34]",         1, LS_UIMM12, 0,        2, LS_WB_NONE, 3, DC, 5, DC, DC, DC, 34, X5 + 34 },
+    { 0x794044a3, "ldrh w3, [x5, #34]",         1, LS_UIMM12, L,        2, LS_WB_NONE, 3, DC, 5, DC, DC, DC, 34, X5 + 34 },
+    { 0x798044a3, "ldrsh x3, [x5, #34]",        1, LS_UIMM12, L|S64,    2, LS_WB_NONE, 3, DC, 5, DC, DC, DC, 34, X5 + 34 },
+    { 0x79c044a3, "ldrsh w3, [x5, #34]",        1, LS_UIMM12, L|S32,    2, LS_WB_NONE, 3, DC, 5, DC, DC, DC, 34, X5 + 34 },
+    { 0xb90044a3, "str w3, [x5, #68]",          1, LS_UIMM12, 0,        4, LS_WB_NONE, 3, DC, 5, DC, DC, DC, 68, X5 + 68 },
+    { 0xb94044a3, "ldr w3, [x5, #68]",          1, LS_UIMM12, L,        4, LS_WB_NONE, 3, DC, 5, DC, DC, DC, 68, X5 + 68 },
+    { 0xb98044a3, "ldrsw x3, [x5, #68]",        1, LS_UIMM12, L|S64,    4, LS_WB_NONE, 3, DC, 5, DC, DC, DC, 68, X5 + 68 },
+    { 0xf90044a3, "str x3, [x5, #136]",         1, LS_UIMM12, 0,        8, LS_WB_NONE, 3, DC, 5, DC, DC, DC, 136, X5 + 136 },
+    { 0xf94044a3, "ldr x3, [x5, #136]",         1, LS_UIMM12, L,        8, LS_WB_NONE, 3, DC, 5, DC, DC, DC, 136, X5 + 136 },
+    { 0xf98004a0, "prfm pldl1keep, [x5, #8]",   1, LS_PREFETCH, DC,    DC, DC,         DC, DC, DC, DC, DC, DC, DC, DC64 },
+
+    /* Integer, signed 9-bit offset: unscaled, post-index, pre-index and unprivileged */
+    { 0x381ff0a3, "sturb w3, [x5, #-1]",        1, LS_IMM9, 0,          1, LS_WB_NONE, 3, DC, 5, DC, DC, DC, -1, X5 - 1 },
+    { 0x785fe0a3, "ldurh w3, [x5, #-2]",        1, LS_IMM9, L,          2, LS_WB_NONE, 3, DC, 5, DC, DC, DC, -2, X5 - 2 },
+    { 0xb89fc0a3, "ldursw x3, [x5, #-4]",       1, LS_IMM9, L|S64,      4, LS_WB_NONE, 3, DC, 5, DC, DC, DC, -4, X5 - 4 },
+    { 0xf80ff0a3, "stur x3, [x5, #255]",        1, LS_IMM9, 0,          8, LS_WB_NONE, 3, DC, 5, DC, DC, DC, 255, X5 + 255 },
+    { 0xb84044a3, "ldr w3, [x5], #4",           1, LS_IMM9, L,          4, LS_WB_POST, 3, DC, 5, DC, DC, DC, 4, X5 },
+    { 0xf85f8ca3, "ldr x3, [x5, #-8]!",         1, LS_IMM9, L,          8, LS_WB_PRE,  3, DC, 5, DC, DC, DC, -8, X5 - 8 },
+    { 0x781fe4a3, "strh w3, [x5], #-2",         1, LS_IMM9, 0,          2, LS_WB_POST, 3, DC, 5, DC, DC, DC, -2, X5 },
+    { 0xb840c8a3, "ldtr w3, [x5, #12]",         1, LS_IMM9, L,          4, LS_WB_NONE, 3, DC, 5, DC, DC, DC, 12, X5 + 12 },
+
+    /* Integer, register offset */
+    { 0x386748a3, "ldrb w3, [x5, w7, uxtw]",    1, LS_REGOFF, L,        1, LS_WB_NONE, 3, DC, 5, 7, 2, 0, DC, X5 + X7 },
+    { 0xb86778a3, "ldr w3, [x5, x7, lsl #2]",   1, LS_REGOFF, L,        4, LS_WB_NONE, 3, DC, 5, 7, 3, 2, DC, X5 + (X7 << 2) },
+    { 0xf867d8a3, "ldr x3, [x5, w7, sxtw #3]",  1, LS_REGOFF, L,        8, LS_WB_NONE, 3, DC, 5, 7, 6, 3, DC, X5 - 16 },
+    { 0x782768a3, "strh w3, [x5, x7]",          1, LS_REGOFF, 0,        2, LS_WB_NONE, 3, DC, 5, 7, 3, 0, DC, X5 + X7 },
+    { 0x38e7e8a3, "ldrsb w3, [x5, x7, sxtx]",   1, LS_REGOFF, L|S32,    1, LS_WB_NONE, 3, DC, 5, 7, 7, 0, DC, X5 + X7 },
+
+    /* Single and double precision FP registers */
+    { 0xbd4004a3, "ldr s3, [x5, #4]",           1, LS_UIMM12, LSF_FP|L, 4, LS_WB_NONE, 3, DC, 5, DC, DC, DC, 4, X5 + 4 },
+    { 0xfd0008a3, "str d3, [x5, #16]",          1, LS_UIMM12, LSF_FP,   8, LS_WB_NONE, 3, DC, 5, DC, DC, DC, 16, X5 + 16 },
+    { 0xbc5fc0a3, "ldur s3, [x5, #-4]",         1, LS_IMM9, LSF_FP|L,   4, LS_WB_NONE, 3, DC, 5, DC, DC, DC, -4, X5 - 4 },
+    { 0xfc1f80a3, "stur d3, [x5, #-8]",         1, LS_IMM9, LSF_FP,     8, LS_WB_NONE, 3, DC, 5, DC, DC, DC, -8, X5 - 8 },
+    { 0xfc6778a3, "ldr d3, [x5, x7, lsl #3]",   1, LS_REGOFF, LSF_FP|L, 8, LS_WB_NONE, 3, DC, 5, 7, 3, 3, DC, X5 + (X7 << 3) },
+    { 0x3d4004a3, "ldr b3, [x5, #1]",           0, LS_INVALID, DC,     DC, DC,         DC, DC, DC, DC, DC, DC, DC, DC64 },
+    { 0x7d4004a3, "ldr h3, [x5, #2]",           0, LS_INVALID, DC,     DC, DC,         DC, DC, DC, DC, DC, DC, DC, DC64 },
+    { 0x3dc004a3, "ldr q3, [x5, #16]",          0, LS_INVALID, DC,     DC, DC,         DC, DC, DC, DC, DC, DC, DC, DC64 },
+
+    /* Integer pairs */
+    { 0x29011ca3, "stp w3, w7, [x5, #8]",       1, LS_PAIR, 0,          4, LS_WB_NONE, 3, 7, 5, DC, DC, DC, 8, X5 + 8 },
+    { 0x297f1ca3, "ldp w3, w7, [x5, #-8]",      1, LS_PAIR, L,          4, LS_WB_NONE, 3, 7, 5, DC, DC, DC, -8, X5 - 8 },
+    { 0x69421ca3, "ldpsw x3, x7, [x5, #16]",    1, LS_PAIR, L|S64,      4, LS_WB_NONE, 3, 7, 5, DC, DC, DC, 16, X5 + 16 },
+    { 0xa9bf1ca3, "stp x3, x7, [x5, #-16]!",    1, LS_PAIR, 0,          8, LS_WB_PRE,  3, 7, 5, DC, DC, DC, -16, X5 - 16 },
+    { 0xa8c21ca3, "ldp x3, x7, [x5], #32",      1, LS_PAIR, L,          8, LS_WB_POST, 3, 7, 5, DC, DC, DC, 32, X5 },
+    { 0x29c09ca3, "ldp w3, w7, [x5, #4]!",      1, LS_PAIR, L,          4, LS_WB_PRE,  3, 7, 5, DC, DC, DC, 4, X5 + 4 },
+    { 0x6d001ca3, "stp d3, d7, [x5]",           0, LS_INVALID, DC,     DC, DC,         DC, DC, DC, DC, DC, DC, DC, DC64 },
+
+    /* PC relative loads, address comes from FAR */
+    { 0x18000203, "ldr w3, #64",                1, LS_LITERAL, L,       4, LS_WB_NONE, 3, DC, DC, DC, DC, DC, DC, FAR },
+    { 0x58000203, "ldr x3, #64",                1, LS_LITERAL, L,       8, LS_WB_NONE, 3, DC, DC, DC, DC, DC, DC, FAR },
+    { 0x98000203, "ldrsw x3, #64",              1, LS_LITERAL, L|S64,   4, LS_WB_NONE, 3, DC, DC, DC, DC, DC, DC, FAR },
+    { 0xd8000200, "prfm pldl1keep, #64",        1, LS_PREFETCH, DC,    DC, DC,         DC, DC, DC, DC, DC, DC, DC, DC64 },
+
+    /* Exclusive and ordered accesses */
+    { 0x885f7ca3, "ldxr w3, [x5]",              1, LS_BASE, L,          4, LS_WB_NONE, 3, DC, 5, DC, DC, DC, DC, X5 },
+    { 0xc85f7ca3, "ldxr x3, [x5]",              1, LS_BASE, L,          8, LS_WB_NONE, 3, DC, 5, DC, DC, DC, DC, X5 },
+    { 0x88077ca3, "stxr w7, w3, [x5]",          1, LS_BASE, LSF_STATUS, 4, LS_WB_NONE, 3, DC, 5, 7, DC, DC, DC, X5 },
+    { 0xc807fca3, "stlxr w7, x3, [x5]",         1, LS_BASE, LSF_STATUS, 8, LS_WB_NONE, 3, DC, 5, 7, DC, DC, DC, X5 },
+    { 0x085ffca3, "ldaxrb w3, [x5]",            1, LS_BASE, L,          1, LS_WB_NONE, 3, DC, 5, DC, DC, DC, DC, X5 },
+    { 0xc8dffca3, "ldar x3, [x5]",              1, LS_BASE, L,          8, LS_WB_NONE, 3, DC, 5, DC, DC, DC, DC, X5 },
+    { 0x889ffca3, "stlr w3, [x5]",              1, LS_BASE, 0,          4, LS_WB_NONE, 3, DC, 5, DC, DC, DC, DC, X5 },
+    { 0x489ffca3, "stlrh w3, [x5]",             1, LS_BASE, 0,          2, LS_WB_NONE, 3, DC, 5, DC, DC, DC, DC, X5 },
+
+    /* Not loads or stores handled by the decoder */
+    { 0xb82700a3, "ldadd w7, w3, [x5]",         0, LS_INVALID, DC,     DC, DC,         DC, DC, DC, DC, DC, DC, DC, DC64 },
+    { 0xd503201f, "nop",                        0, LS_INVALID, DC,     DC, DC,         DC, DC, DC, DC, DC, DC, DC, DC64 },
+    { 0x910004a3, "add x3, x5, #1",             0, LS_INVALID, DC,     DC, DC,         DC, DC, DC, DC, DC, DC, DC, DC64 },
+};
+
+struct ExtendCase {
+    uint8_t     size;
+    uint8_t     flags;
+    uint64_t    value;
+    uint64_t    result;
+};
+
+static const struct ExtendCase extends[] = {
+    { 1, L,         0x80,               0x80 },
+    { 1, L|S32,     0x80,               0xffffff80 },
+    { 1, L|S64,     0x80,               0xffffffffffffff80ULL },
+    { 2, L,         0x8001,             0x8001 },
+    { 2, L|S32,     0x8001,             0xffff8001 },
+    { 2, L|S64,     0x7fff,             0x7fff },
+    { 4, L,         0x80000000,         0x80000000 },
+    { 4, L|S64,     0x80000000,         0xffffffff80000000ULL },
+    { 8, L,         0x8000000000000000ULL, 0x8000000000000000ULL },
+};
+
+static int check(const char *name, const char *field, long expected, long actual)
+{
+    if (expected == DC || expected == actual)
+        return 0;
+
+    printf("FAIL %-28s %s: expected %ld, got %ld\n", name, field, expected, actual);
+
+    return 1;
+}
+
+int main()
+{
+    uint64_t ctx[32] = { 0 };
+    int failed = 0;
+
+    ctx[5] = X5;
+    ctx[7] = X7;
+
+    for (unsigned i=0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    {
+        const struct TestCase *t = &tests[i];
+        struct LSInsn li;
+        int ok = SYSDecodeLoadStore(t->opcode, &li);
+        int f = 0;
+
+        f |= check(t->name, "result", t->ok, ok);
+        f |= check(t->name, "form", t->form, li.li_Form);
+
+        if (ok && t->form != LS_PREFETCH)
+        {
+            f |= check(t->name, "flags", t->flags, li.li_Flags);
+            f |= check(t->name, "size", t->size, li.li_Size);
+            f |= check(t->name, "writeback", t->writeback, li.li_Writeback);
+            f |= check(t->name, "rt", t->rt, li.li_Rt);
+            f |= check(t->name, "rt2", t->rt2, li.li_Rt2);
+            f |= check(t->name, "rn", t->rn, li.li_Rn);
+            f |= check(t->name, "rm", t->rm, li.li_Rm);
+            f |= check(t->name, "extend", t->extend, li.li_Extend);
+            f |= check(t->name, "shift", t->shift, li.li_Shift);
+            f |= check(t->name, "offset", t->offset, li.li_Offset);
+
+            if (t->addr != DC64)
+            {
+                uint64_t addr = SYSEffectiveAddress(&li, ctx, FAR);
+
+                if (addr != t->addr)
+                {
+                    printf("FAIL %-28s address: expected %llx, got %llx\n", t->name,
+                        (unsigned long long)t->addr, (unsigned long long)addr);
+                    f = 1;
+                }
+            }
+        }
+
+        failed += f;
+    }
+
+    for (unsigned i=0; i < sizeof(extends) / sizeof(extends[0]); i++)
+    {
+        struct LSInsn li = { 0 };
+        uint64_t result;
+
+        li.li_Size = extends[i].size;
+        li.li_Flags = extends[i].flags;
+        result = SYSExtendValue(&li, extends[i].value);
+
+        if (result != extends[i].result)
+        {
+            printf("FAIL extend of %llx, size %d, flags %02x: expected %llx, got %llx\n",
+                (unsigned long long)extends[i].value, extends[i].size, extends[i].flags,
+                (unsigned long long)extends[i].result, (unsigned long long)result);
+            failed++;
+        }
+    }
+
+    printf("%d of %d decoder and %d extend cases failed\n", failed,
+        (int)(sizeof(tests) / sizeof(tests[0])), (int)(sizeof(extends) / sizeof(extends[0])));
+
+    return failed != 0;
+}